@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <db/Database.hpp>
+#include <functional>
+#include <random>
+#include <thread>
+
+// Compares the replacement policies of the BufferPool on a few access patterns. Each pattern is run on a fresh pool,
+// single threaded with getPage() and then with several threads pinning pages.
+
+namespace {
+    constexpr size_t FILE_PAGES = 4 * db::DEFAULT_NUM_PAGES;
+    constexpr size_t ACCESSES = 200000;
+
+    struct Pattern {
+        const char *name;
+        // The page of the i-th access of a thread.
+        std::function<size_t(std::mt19937 &, size_t)> page;
+    };
+
+    void run(const Pattern &pattern, db::Replacement replacement, const char *policy, size_t threads) {
+        auto pool = std::make_unique<db::BufferPool>(db::BufferPoolOptions{.replacement = replacement});
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                std::mt19937 rng(t);
+                for (size_t i = 0; i < ACCESSES / threads; ++i) {
+                    db::PageId pid{"bench.dat", pattern.page(rng, i)};
+                    if (threads == 1) {
+                        pool->getPage(pid);
+                    } else {
+                        pool->pin(pid);
+                    }
+                }
+            });
+        }
+        for (auto &worker: workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        db::PageStats stats = pool->getStats();
+        std::printf("%-10s %-6s %2zu threads %8.1f ns/access %6.2f%% hits\n", pattern.name, policy, threads,
+                    seconds * 1e9 / ACCESSES, 100.0 * stats.hits / (stats.hits + stats.misses));
+    }
+} // namespace
+
+int main() {
+    std::remove("bench.dat");
+    db::getDatabase().add(std::make_unique<db::DbFile>("bench.dat", db::TupleDesc()));
+
+    std::vector<Pattern> patterns{
+            {"hot",     [](std::mt19937 &rng, size_t) { return rng() % (db::DEFAULT_NUM_PAGES / 2); }},
+            {"skewed",  [](std::mt19937 &rng, size_t) {
+                // 80% of the accesses go to 20% of the pages.
+                size_t hot = FILE_PAGES / 5;
+                return rng() % 10 < 8 ? rng() % hot : hot + rng() % (FILE_PAGES - hot);
+            }},
+            {"uniform", [](std::mt19937 &rng, size_t) { return rng() % FILE_PAGES; }},
+            {"scan",    [](std::mt19937 &, size_t i) { return i % FILE_PAGES; }},
+            {"mixed",   [](std::mt19937 &rng, size_t i) {
+                // A scan of the file interleaved with lookups of a few hot pages, like probes into an index.
+                return i % 4 == 0 ? rng() % (db::DEFAULT_NUM_PAGES / 5) : i % FILE_PAGES;
+            }},
+    };
+    size_t threads = std::max<size_t>(2, std::thread::hardware_concurrency());
+    for (const auto &pattern: patterns) {
+        for (size_t n: {size_t{1}, threads}) {
+            run(pattern, db::Replacement::LRU, "LRU", n);
+            run(pattern, db::Replacement::CLOCK, "CLOCK", n);
+            run(pattern, db::Replacement::TWO_Q, "2Q", n);
+        }
+    }
+
+    db::getDatabase().remove("bench.dat");
+    std::remove("bench.dat");
+}
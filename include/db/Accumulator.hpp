@@ -0,0 +1,147 @@
+#pragma once
+
+#include <db/Query.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace db {
+/**
+ * @brief The running state of one aggregate over one group.
+ * @details Only what the operation needs is kept, so memory does not depend on the number of tuples in the group.
+ * Values are added one at a time or a column at a time, and accumulators of partial aggregations can be merged.
+ */
+    class Accumulator {
+        AggregateOp op;
+        size_t count = 0;
+        double sum = 0;
+        field_t value;
+
+    public:
+        explicit Accumulator(AggregateOp op) : op(op) {}
+
+        template<typename T>
+        void add(const T &v) {
+            switch (op) {
+                case AggregateOp::COUNT:
+                    break;
+                case AggregateOp::SUM:
+                    if constexpr (std::is_same_v<T, std::string>) {
+                        throw std::logic_error("Cannot sum non-numeric field");
+                    } else if (count == 0) {
+                        value = v;
+                    } else {
+                        std::get<T>(value) += v;
+                    }
+                    break;
+                case AggregateOp::AVG:
+                    if constexpr (std::is_same_v<T, std::string>) {
+                        throw std::logic_error("Cannot average non-numeric field");
+                    } else {
+                        sum += v;
+                    }
+                    break;
+                case AggregateOp::MIN:
+                    if (count == 0 || v < std::get<T>(value)) value = v;
+                    break;
+                case AggregateOp::MAX:
+                    if (count == 0 || std::get<T>(value) < v) value = v;
+                    break;
+            }
+            ++count;
+        }
+
+        void add(const field_t &v) {
+            std::visit([this](const auto &x) { add(x); }, v);
+        }
+
+        // Adds a whole column with one loop over the values, in the same order as adding them one at a time.
+        template<typename T>
+        void addAll(const std::vector<T> &values) {
+            if (values.empty()) return;
+            if constexpr (std::is_same_v<T, std::string>) {
+                for (const auto &v: values) add(v);
+            } else {
+                switch (op) {
+                    case AggregateOp::COUNT:
+                        break;
+                    case AggregateOp::SUM: {
+                        T s = count == 0 ? T() : std::get<T>(value);
+                        for (const T v: values) s += v;
+                        value = s;
+                        break;
+                    }
+                    case AggregateOp::AVG: {
+                        double s = sum;
+                        for (const T v: values) s += v;
+                        sum = s;
+                        break;
+                    }
+                    case AggregateOp::MIN: {
+                        T m = count == 0 ? values[0] : std::get<T>(value);
+                        for (const T v: values) m = std::min(m, v);
+                        value = m;
+                        break;
+                    }
+                    case AggregateOp::MAX: {
+                        T m = count == 0 ? values[0] : std::get<T>(value);
+                        for (const T v: values) m = std::max(m, v);
+                        value = m;
+                        break;
+                    }
+                }
+                count += values.size();
+            }
+        }
+
+        // Combines the state of an accumulator of the same operation that saw other tuples of the group.
+        void merge(const Accumulator &other) {
+            if (other.count == 0) return;
+            switch (op) {
+                case AggregateOp::COUNT:
+                    break;
+                case AggregateOp::SUM:
+                    if (count == 0) {
+                        value = other.value;
+                    } else {
+                        std::visit([&](auto &v) {
+                            using T = std::decay_t<decltype(v)>;
+                            if constexpr (!std::is_same_v<T, std::string>) v += std::get<T>(other.value);
+                        }, value);
+                    }
+                    break;
+                case AggregateOp::AVG:
+                    sum += other.sum;
+                    break;
+                case AggregateOp::MIN:
+                    if (count == 0 || other.value < value) value = other.value;
+                    break;
+                case AggregateOp::MAX:
+                    if (count == 0 || value < other.value) value = other.value;
+                    break;
+            }
+            count += other.count;
+        }
+
+        field_t result() const {
+            switch (op) {
+                case AggregateOp::COUNT:
+                    return static_cast<int>(count);
+                case AggregateOp::AVG:
+                    return sum / count;
+                default:
+                    return value;
+            }
+        }
+    };
+
+/**
+ * @brief Hash of a composite group key.
+ */
+    struct KeyHash {
+        size_t operator()(const std::vector<field_t> &key) const {
+            size_t h = 0;
+            for (const auto &f: key) h = h * 31 + std::hash<field_t>()(f);
+            return h;
+        }
+    };
+} // namespace db
@@ -1,12 +1,21 @@
 #pragma once
 
 #include <db/DbFile.hpp>
+#include <mutex>
 
 namespace db {
 
     class BTreeFile : public DbFile {
         static constexpr size_t root_id = 0;
         size_t key_index;
+        // The leaves in key order, collected from the index pages when the file had leaf_pages pages, and the rank of
+        // each page in it (SIZE_MAX for index pages). Used to prefetch the leaves that follow the one a scan is on.
+        mutable std::mutex leaf_mutex;
+        mutable std::vector<size_t> leaf_order;
+        mutable std::vector<size_t> leaf_rank;
+        mutable size_t leaf_pages = 0;
+
+        void prefetchLeaves(size_t leaf) const;
 
     public:
 
@@ -14,8 +23,16 @@ namespace db {
          * @brief Initialize a BTreeFile
          *
          * @param key_index the index of the key in the tuple
+         * @param page_size the page size of the file if it is created, see DbFile
          */
-        BTreeFile(const std::string &name, const TupleDesc &td, size_t key_index);
+        BTreeFile(const std::string &name, const TupleDesc &td, size_t key_index, size_t page_size = DEFAULT_PAGE_SIZE);
+
+        /**
+         * @brief Get the index of the key in the tuple
+         * @details Iterating the file yields tuples in ascending order of this field.
+         * @return the index of the key in the tuple
+         */
+        size_t getKeyIndex() const;
 
         /**
          * @brief Insert a tuple into the file
@@ -52,6 +69,24 @@ namespace db {
          */
         Iterator begin() const override;
 
+        /**
+         * @brief Get the iterator to the first tuple whose key is not less than the given key.
+         * @details Traverse the tree from the root to the leftmost leaf that may contain the key and binary search it.
+         * If every key of that leaf is smaller, continue with the next leaf. The returned iterator can be advanced with
+         * next() to visit the following keys in ascending order.
+         * @param key The key to look up.
+         * @return The iterator to the first tuple with a key not less than key, or end() if there is none.
+         */
+        Iterator seek(int key) const;
+
+        /**
+         * @brief Get the page numbers of the leaves in ascending key order.
+         * @details Collected level by level from the index pages, so the leaves themselves are not read. This lets a scan
+         * be split into ranges of leaves without following the next_leaf chain.
+         * @return The page numbers of the leaves, empty if the tree has no tuples.
+         */
+        std::vector<size_t> leaves() const;
+
         /**
          * @brief Get the iterator to the end of the file.
          * @details Return an iterator that points to the end of the file.
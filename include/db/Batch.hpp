@@ -0,0 +1,90 @@
+#pragma once
+
+#include <db/Tuple.hpp>
+#include <variant>
+#include <vector>
+
+namespace db {
+    /// The number of tuples moved between operators at a time.
+    constexpr size_t BATCH_SIZE = 1024;
+
+    /// The values of one column of a Batch.
+    using column_t = std::variant<std::vector<int>, std::vector<double>, std::vector<std::string>>;
+
+/**
+ * @brief A group of up to BATCH_SIZE tuples stored column by column.
+ * @details Each column is a vector of a primitive type, so operators can evaluate predicates and aggregates with
+ * tight loops over arrays instead of visiting a field_t per row.
+ */
+    class Batch {
+        std::vector<column_t> columns;
+        size_t rows = 0;
+
+    public:
+        Batch() = default;
+
+        /**
+         * @brief Construct an empty batch with one column per field of the tuple descriptor.
+         * @param td the tuple descriptor of the tuples stored in the batch
+         */
+        explicit Batch(const TupleDesc &td);
+
+        /**
+         * @brief Get the number of tuples in the batch
+         */
+        size_t size() const;
+
+        /**
+         * @brief Get the number of columns in the batch
+         */
+        size_t width() const;
+
+        /**
+         * @brief Remove all tuples, keeping the columns and their capacity
+         */
+        void clear();
+
+        /**
+         * @brief Append a tuple
+         * @param t the tuple to append, which must match the column types
+         */
+        void append(const Tuple &t);
+
+        /**
+         * @brief Append a serialized tuple
+         * @details The fields are read directly from the buffer without building a Tuple.
+         * @param data the buffer holding a tuple serialized with td
+         * @param td the tuple descriptor the batch was constructed with
+         */
+        void append(const uint8_t *data, const TupleDesc &td);
+
+        const column_t &column(size_t i) const;
+
+        column_t &column(size_t i);
+
+        /**
+         * @brief Get a field of a tuple
+         * @param row the position of the tuple in the batch
+         * @param i the index of the field
+         */
+        field_t get_field(size_t row, size_t i) const;
+
+        /**
+         * @brief Build the tuple at a position of the batch
+         * @param row the position of the tuple in the batch
+         */
+        Tuple get_tuple(size_t row) const;
+
+        /**
+         * @brief Keep only the selected tuples, preserving their order
+         * @param selection one entry per tuple, non-zero for the tuples to keep
+         */
+        void select(const std::vector<uint8_t> &selection);
+
+        /**
+         * @brief Replace the columns with the listed ones
+         * @param indices the indices of the columns to keep, in their new order (an index may repeat)
+         */
+        void project(const std::vector<size_t> &indices);
+    };
+} // namespace db
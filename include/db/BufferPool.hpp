@@ -1,7 +1,19 @@
 #pragma once
 
+#include <db/IoQueue.hpp>
+#include <db/PageTable.hpp>
+#include <db/ReplacementPolicy.hpp>
 #include <db/types.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -9,33 +21,282 @@
 namespace db {
     constexpr size_t DEFAULT_NUM_PAGES = 50;
 
+    /// The number of independently locked partitions of the page table.
+    constexpr size_t PAGE_TABLE_STRIPES = 16;
+
+    /// The size of a huge page, the alignment of the memory of a BufferPool that asks for them.
+    constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+    /// How often the background writer of a BufferPool checks the proportion of dirty pages.
+    constexpr std::chrono::milliseconds FLUSH_INTERVAL{10};
+
+    /// The most consecutive pages the background writer of a BufferPool writes with one system call.
+    constexpr size_t FLUSH_RUN = 64;
+
+    /// How a BufferPool is sized and managed.
+    struct BufferPoolOptions {
+        /// The number of pages the pool holds.
+        size_t pages = DEFAULT_NUM_PAGES;
+        /// The size of the frames, the largest page size of the files whose pages the pool holds. A frame only uses
+        /// the memory of the page it holds, unless the pool is backed by huge pages.
+        size_t page_size = MAX_PAGE_SIZE;
+        /// The policy that chooses the page to evict.
+        Replacement replacement = Replacement::LRU;
+        /// Whether the pages are backed by huge pages, to reduce TLB misses in large pools.
+        bool huge_pages = false;
+        /// The number of pages read ahead of a scan, 0 to disable prefetching.
+        size_t prefetch_depth = 0;
+        /// The proportion of dirty pages above which a background thread writes them back, 0 to disable it.
+        double dirty_threshold = 0;
+    };
+
+    /// How a pinned page is latched.
+    enum class Latch {
+        SHARED, EXCLUSIVE
+    };
+
+    class BufferPool;
+
+    /// The number of page requests a BufferPool served from memory and from disk, and of pages read ahead of them.
+    struct PageStats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t prefetched = 0;
+    };
+
+    /// The pages the background writer of a BufferPool wrote back, and the number of writes it took.
+    struct FlushStats {
+        size_t pages = 0;
+        size_t writes = 0;
+        /// The pages written back per second.
+        double rate = 0;
+    };
+
+/**
+ * @brief A page pinned in a BufferPool, latched for as long as the guard lives.
+ * @details The page cannot be evicted while the guard exists. A SHARED guard allows other SHARED guards of the same
+ * page, an EXCLUSIVE guard allows none. The guard is released when it is destroyed or moved from.
+ * @note A DbFile mapped in memory hands out guards of the pages of its mapping, which involve no BufferPool and cannot
+ * be marked dirty.
+ */
+    class PageGuard {
+        BufferPool *pool;
+        size_t frame;
+        Latch latch;
+        // The page in the mapping of a DbFile, for guards without a pool.
+        std::span<uint8_t> mapped;
+
+        friend class BufferPool;
+        friend class DbFile;
+
+        PageGuard(BufferPool *pool, size_t frame, Latch latch);
+
+        explicit PageGuard(std::span<const uint8_t> mapped);
+
+    public:
+        PageGuard(PageGuard &&other) noexcept;
+
+        PageGuard &operator=(PageGuard &&other) noexcept;
+
+        PageGuard(const PageGuard &) = delete;
+
+        PageGuard &operator=(const PageGuard &) = delete;
+
+        ~PageGuard();
+
+        /**
+         * @brief: Returns the pinned page, of the page size of its file.
+         */
+        std::span<uint8_t> page() const;
+
+        /**
+         * @brief: Marks the pinned page as dirty.
+         * @throws std::logic_error if the page is in the mapping of a DbFile.
+         */
+        void markDirty() const;
+
+        /**
+         * @brief: Unlatches and unpins the page before the guard is destroyed.
+         */
+        void release();
+    };
+
 /**
  * @brief Represents a buffer pool for database pages.
  * @details The BufferPool class is responsible for managing the database pages in memory.
+ * The pages are stored in a single page-aligned allocation sized at construction, in frames of the page size of the
+ * options, which bounds the page size of the files the pool can hold; a page smaller than its frame uses its start.
+ * The allocation only reserves address space: the memory of a frame is allocated as the page it holds is written,
+ * and the memory past the end of a page is given back when a frame that held a larger page is reused, so a frame
+ * costs the page size of its file whatever the page size of the options.
+ * The frames are aligned for the direct I/O of DbFile::setDirect(). With huge pages, the allocation is
+ * taken from the reserved huge pages (MAP_HUGETLB) if there are enough of them, and otherwise aligned to HUGE_PAGE_SIZE
+ * and marked for transparent huge pages (MADV_HUGEPAGE). Huge pages back whole frames, so a pool of huge pages should
+ * be given the largest page size of its files.
  * It provides functions to get a page, mark a page as dirty, and check the status of pages.
  * The class also supports flushing pages to disk and discarding pages from the buffer pool.
  * @note A BufferPool owns the Page objects that are stored in it.
+ * @note All methods may be called from several threads. The page table is split in PAGE_TABLE_STRIPES partitions with a
+ * mutex each, and the replacement policy and free slots have a mutex of their own, so lookups of different pages rarely
+ * contend. Each slot has a pin count and a read/write latch: pin() returns a PageGuard that keeps the page in the pool
+ * and latched until it is released, and eviction skips pinned slots. The slot to evict is chosen by a
+ * ReplacementPolicy, LRU unless another one is given at construction. A page is read from disk while its slot is
+ * latched exclusively, so threads asking for a page that is being loaded wait for the read instead of loading it again.
+ * getPage() pins the page only for the duration of the call; the returned reference is only safe while no other thread
+ * can evict the page.
+ * @note Batches of page I/O, the reads ahead of a scan and the writes of flushFile() and of the destructor, are run by
+ * an IoQueue, through io_uring when it is available.
+ * @note With a dirty threshold, a background writer keeps the proportion of dirty pages under it, so that evictions
+ * rarely have to write a page back. Every FLUSH_INTERVAL, and as soon as the threshold is crossed, it writes back the
+ * dirty pages that are not latched exclusively, with one pwritev for each run of consecutive pages of a file.
+ * @note With a prefetch depth, a background thread reads pages ahead of scans. Requests for consecutive pages of a
+ * file are detected and the following pages are read ahead; scans whose pages are not consecutive, like the leaves of
+ * a BTreeFile, call prefetch() with a function that finds the page following a page.
  */
     class BufferPool {
-        // TODO pa0: add private members
-        // The fixed array of pages.
-        std::array<Page, DEFAULT_NUM_PAGES> pages_;
-        // Map from PageId to slot index.
-        std::unordered_map<PageId, size_t, std::hash<const PageId>> page_table_;
-        // LRU list: front is most recently used.
-        std::list<PageId> lru_list_;
-        // Map from PageId to its iterator in lru_list_.
-        std::unordered_map<PageId, std::list<PageId>::iterator, std::hash<const PageId>> lru_map_;
-        // Set of dirty pages.
-        std::unordered_set<PageId, std::hash<const PageId>> dirty_pages_;
+        // Hit and miss counters of a file, and the state of the detection of sequential requests.
+        struct Counters {
+            std::atomic<size_t> hits{0};
+            std::atomic<size_t> misses{0};
+            std::atomic<size_t> prefetched{0};
+            // The page that continues the last request, and the last page requested from the prefetcher.
+            std::atomic<uint32_t> expected{UINT32_MAX};
+            std::atomic<uint32_t> ahead{0};
+        };
+
+        // A request to read count pages, starting from pid and moving to the page next returns or the following page.
+        struct Prefetch {
+            PageId pid;
+            size_t count;
+            std::function<std::optional<size_t>(std::span<const uint8_t>)> next;
+        };
+
+        // A slot of the pool: the page it holds and the page size of its file, its dirty flag, pin count and latch.
+        struct Frame {
+            PageId pid;
+            size_t size = DEFAULT_PAGE_SIZE;
+            Counters *counters = nullptr;
+            std::atomic<bool> dirty{false};
+            std::atomic<size_t> pins{0};
+            std::shared_mutex latch;
+        };
+
+        // A partition of the page table.
+        struct Stripe {
+            std::mutex mutex;
+            PageTable table;
+        };
+
+        // The number of slots.
+        size_t num_pages_;
+        // The size of a slot, of which only the page size of its page is backed by memory without huge pages.
+        size_t frame_size_;
+        bool huge_pages_;
+        // The pages, num_pages_ slots of frame_size_ bytes at the start of a mapping of mapped_ bytes at memory_.
+        uint8_t *pages_;
+        void *memory_;
+        size_t mapped_;
+        // The state of each slot of pages_.
+        std::unique_ptr<Frame[]> frames_;
+        // Map from PageId to slot index, partitioned by the hash of the PageId.
+        mutable std::array<Stripe, PAGE_TABLE_STRIPES> stripes_;
+        // Tracks the slots holding a page and picks the next one to evict.
+        std::unique_ptr<ReplacementPolicy> policy_;
+        // Guards free_slots_.
+        std::mutex free_mutex_;
         // Free slots (indices into pages_).
         std::list<size_t> free_slots_;
-        
+        // Guards counters_.
+        mutable std::mutex stats_mutex_;
+        // Counters of every file that was requested, which frames point to. Erased only once the pages of the file
+        // are discarded.
+        std::unordered_map<uint32_t, Counters> counters_;
+        // The number of pages read ahead of a sequential scan.
+        size_t prefetch_depth_;
+        // Guards prefetches_, prefetching_ and stopping_.
+        std::mutex prefetch_mutex_;
+        // Signals new requests to the prefetcher.
+        std::condition_variable prefetch_cv_;
+        // Signals the completion of a request.
+        std::condition_variable idle_cv_;
+        std::deque<Prefetch> prefetches_;
+        // The file of the request the prefetcher is processing.
+        std::optional<uint32_t> prefetching_;
+        bool stopping_ = false;
+        std::thread prefetcher_;
+        // Runs the batches of reads of the prefetcher and of writes of the flushes.
+        IoQueue io_;
+        // The number of dirty slots.
+        std::atomic<size_t> dirty_pages_{0};
+        // The number of dirty slots that wakes the writer up, 0 if there is no writer.
+        size_t dirty_limit_;
+        // Guards flush_stopping_, writing_ and discarding_.
+        std::mutex flush_mutex_;
+        // Wakes the writer up early.
+        std::condition_variable flush_cv_;
+        // Signals that the writer unpinned the pages of a file.
+        std::condition_variable written_cv_;
+        bool flush_stopping_ = false;
+        // The files the writer holds pinned pages of, and the files being discarded, which it leaves alone.
+        std::unordered_set<uint32_t> writing_;
+        std::unordered_set<uint32_t> discarding_;
+        // What the writer wrote since flush_start_.
+        std::atomic<size_t> flushed_pages_{0};
+        std::atomic<size_t> flush_writes_{0};
+        std::atomic<std::chrono::steady_clock::rep> flush_start_;
+        std::thread flusher_;
+
+        friend class PageGuard;
+
+        Stripe &stripe(const PageId &pid) const;
+
+        std::span<uint8_t> data(size_t slot) const;
+
+        size_t fetch(const PageId &pid, bool prefetch = false);
+
+        std::pair<size_t, bool> claim(const PageId &pid, bool prefetch);
+
+        void loaded(size_t slot);
+
+        void abandon(size_t slot);
+
+        void sequential(Counters &counters, const PageId &pid);
+
+        void prefetchLoop();
+
+        void readAhead(const Prefetch &request, const Counters &counters);
+
+        void follow(const Prefetch &request);
+
+        void cancelPrefetches(uint32_t file);
+
+        size_t victim();
+
+        void unpin(size_t slot);
+
+        void setDirty(size_t slot);
+
+        bool takeDirty(size_t slot);
+
+        void flushLoop();
+
+        void writeBack();
+
+        template<typename F>
+        void forEach(const F &f) const;
+
+        template<typename F>
+        void flushAll(const F &select);
+
     public:
         /**
-         * @brief: Constructs a BufferPool object with the default number of pages.
+         * @brief: Constructs a BufferPool object.
+         * @param options: The number of pages, the replacement policy and the backing of the pool.
+         * @throws std::invalid_argument if the number of pages is zero, the page size is not valid or the dirty
+         * threshold is not in [0, 1].
+         * @throws std::runtime_error if the memory of the pool cannot be mapped.
          */
-        explicit BufferPool();
+        explicit BufferPool(const BufferPoolOptions &options = {});
 
         /**
          * @brief: Destructs a BufferPool object after flushing all dirty pages to disk.
@@ -50,14 +311,63 @@ namespace db {
 
         BufferPool &operator=(BufferPool &&) = delete;
 
+        /**
+         * @brief: Returns the number of pages the pool holds.
+         */
+        size_t getNumPages() const;
+
+        /**
+         * @brief: Returns the size of the frames, the largest page size of the files whose pages the pool holds.
+         */
+        size_t getPageSize() const;
+
         /**
          * @brief: Returns the page with the specified page id.
          * @param pid: The page id of the page to return.
-         * @return: The page with the specified page id.
+         * @return: The page with the specified page id. Only its first DEFAULT_PAGE_SIZE bytes are in the Page of a file
+         * with larger pages: use getPageBytes() for those.
          * @note This method should make this page the most recently used page.
          */
         Page &getPage(const PageId &pid);
 
+        /**
+         * @brief: Returns the page with the specified page id like getPage(), with the page size of its file.
+         * @throws std::logic_error if the pages of the file are larger than the frames of the pool.
+         */
+        std::span<uint8_t> getPageBytes(const PageId &pid);
+
+        /**
+         * @brief: Pins and latches the page with the specified page id, loading it if needed.
+         * @param pid: The page id of the page to pin.
+         * @param latch: Whether the page is latched for reading or for writing.
+         * @return: A guard that keeps the page pinned and latched until it is released.
+         * @throws std::runtime_error if every slot is pinned and no page can be evicted.
+         * @throws std::logic_error if the pages of the file are larger than the frames of the pool.
+         * @note This method makes this page the most recently used page.
+         */
+        PageGuard pin(const PageId &pid, Latch latch = Latch::SHARED);
+
+        /**
+         * @brief: Returns the number of pages read ahead of a scan, 0 if prefetching is disabled.
+         */
+        size_t getPrefetchDepth() const;
+
+        /**
+         * @brief: Reads pages in the background, if prefetching is enabled.
+         * @param pid: The first page to read.
+         * @param count: The number of pages to read.
+         * @param next: Returns the page number that follows a page, or nothing at the end of the chain. If empty, the
+         * pages are consecutive and the request stops at the end of the file.
+         * @note Pages that are already in the pool are not read again, but are pinned to find their successor.
+         */
+        void prefetch(const PageId &pid, size_t count,
+                      std::function<std::optional<size_t>(std::span<const uint8_t>)> next = {});
+
+        /**
+         * @brief: Waits until the prefetcher has processed every request.
+         */
+        void drainPrefetches();
+
         /**
          * @brief: Marks the page with the specified page id as dirty.
          * @param pid: The page id of the page to mark as dirty.
@@ -83,6 +393,7 @@ namespace db {
          * @param pid: The page id of the page to discard.
          * @note This method does NOT flush the page to disk.
          * @note This method also updates the LRU and dirty pages to exclude tracking this page.
+         * @throws std::logic_error if the page is pinned.
          */
         void discardPage(const PageId &pid);
 
@@ -96,8 +407,45 @@ namespace db {
         /**
          * @brief: Flushes all dirty pages in the specified file to disk.
          * @param file: The name of the associated file.
-         * @note This method should call BufferPool::flushPage(pid).
+         * @note The pages are written in a single batch of the IoQueue of the pool.
+         * @throws std::runtime_error if a page could not be written; it stays dirty.
          */
         void flushFile(const std::string &file);
+
+        /**
+         * @brief: Discards all pages of the specified file from the buffer pool.
+         * @param file: The name of the associated file.
+         * @note This method does NOT flush the pages to disk. It is meant for files that are about to be deleted.
+         * The hit and miss counters of the file are dropped as well, and so is what the ReplacementPolicy remembers of
+         * its evicted pages, so that its id can be given to another file. Waits for the background writer to be done
+         * with the pages of the file, and keeps it away from them meanwhile.
+         */
+        void discardFile(const std::string &file);
+
+        /**
+         * @brief: Returns the number of hits and misses of getPage() and pin() over all files.
+         */
+        PageStats getStats() const;
+
+        /**
+         * @brief: Returns the number of hits and misses of getPage() and pin() for the pages of a file.
+         * @param file: The name of the file.
+         */
+        PageStats getStats(const std::string &file) const;
+
+        /**
+         * @brief: Returns the proportion of the pages of the pool that are dirty.
+         */
+        double getDirtyRatio() const;
+
+        /**
+         * @brief: Returns what the background writer wrote back since the construction or the last resetStats().
+         */
+        FlushStats getFlushStats() const;
+
+        /**
+         * @brief: Sets all hit and miss counts, and the counts of the background writer, to zero.
+         */
+        void resetStats();
     };
 } // namespace db
@@ -3,6 +3,7 @@
 #include <db/BufferPool.hpp>
 #include <db/DbFile.hpp>
 #include <memory>
+#include <shared_mutex>
 
 /**
  * @brief A database is a collection of files and a BufferPool.
@@ -16,9 +17,14 @@ namespace db {
         // TODO pa0: add private members
         std::unordered_map<std::string, std::unique_ptr<DbFile>> files_;    // Maps file names to DBFile objects
 
-        BufferPool bufferPool;
+        mutable std::shared_mutex ids_mutex_;                              // Guards ids_, by_id_ and free_ids_
+        std::unordered_map<std::string, uint32_t> ids_;                    // Maps the names of the files to their ids
+        std::vector<DbFile *> by_id_;                                      // Maps ids to the added file, if any
+        std::vector<uint32_t> free_ids_;                                   // Ids of removed files, to reuse
 
-        Database() = default;
+        std::unique_ptr<BufferPool> bufferPool;
+
+        Database();
 
     public:
         friend Database &getDatabase();
@@ -37,6 +43,13 @@ namespace db {
          */
         BufferPool &getBufferPool();
 
+        /**
+         * @brief Replaces the BufferPool with a new one.
+         * @param options The number of pages, the replacement policy and the backing of the new BufferPool.
+         * @note The dirty pages of the current BufferPool are flushed first. No page of it may be pinned or in use.
+         */
+        void setBufferPool(const BufferPoolOptions &options);
+
         /**
          * @brief Adds a new file to the Database.
          * @param file The file to add.
@@ -51,6 +64,8 @@ namespace db {
          * @return The removed file.
          * @throws std::logic_error if the name does not exist.
          * @note This method should call BufferPool::flushFile(name)
+         * @note The pages of the file are then discarded from the BufferPool, and its id is reused for the next file
+         * added. None of its pages may be pinned.
          * @note This method moves the DbFile ownership to the caller.
          */
         std::unique_ptr<DbFile> remove(const std::string &name);
@@ -62,6 +77,22 @@ namespace db {
          * @throws std::logic_error if the name does not exist.
          */
         DbFile &get(const std::string &name) const;
+
+        /**
+         * @brief Returns the DbFile of the specified id.
+         * @param id The interned id of the name of the file.
+         * @return The DbFile object.
+         * @throws std::logic_error if no file with this id was added.
+         */
+        DbFile &get(uint32_t id) const;
+
+        /**
+         * @brief Returns the internal id of a file name.
+         * @details add() gives each file an id that no other file holds, reusing the ids of removed files.
+         * @param name The name of the file.
+         * @return The id of the file, or NO_FILE if no file of this name was added.
+         */
+        uint32_t getId(const std::string &name) const;
     };
 
 /**
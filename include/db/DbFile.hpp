@@ -1,10 +1,20 @@
 #pragma once
 
+#include <db/Batch.hpp>
+#include <db/BufferPool.hpp>
+#include <db/IoQueue.hpp>
 #include <db/Iterator.hpp>
 #include <db/types.hpp>
+#include <mutex>
+#include <span>
 #include <vector>
 
 namespace db {
+    /// The alignment of the buffers, offsets and lengths of the reads and writes of a file opened for direct I/O.
+    constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+
+    /// The size of the header that records the page size of a file whose pages are not DEFAULT_PAGE_SIZE bytes.
+    constexpr size_t FILE_HEADER_SIZE = 4096;
 
 /**
  * @brief Represents a database file.
@@ -15,25 +25,49 @@ namespace db {
     class DbFile {
         mutable std::vector<size_t> reads;
         mutable std::vector<size_t> writes;
+        mutable std::mutex log_mutex;
 
         // TODO pa1: add private members
         int fd;
+        // The read-only mapping of the file, if it is mapped, and the number of pages it covers.
+        const uint8_t *mapping = nullptr;
+        size_t mapped_pages = 0;
+        // Whether the file is accessed with O_DIRECT.
+        bool direct = false;
+
+        friend class Database;
 
     protected:
         const std::string name;
+        // The interned id of the name, assigned when the file is added to the Database.
+        uint32_t id = NO_FILE;
         const TupleDesc td;
         size_t numPages;
+        size_t page_size;
+        // The offset of page 0: FILE_HEADER_SIZE if the file has a header, 0 otherwise.
+        size_t base = 0;
+
+        off_t offset(size_t id) const;
+
+        /**
+         * @brief Throw std::logic_error if the file is mapped, and thus read-only.
+         */
+        void checkWritable() const;
 
     public:
         /**
          * @brief Construct a new Db File object with the specified file name and tuple descriptor
          * @param name of the file to be opened or created.
          * @param td tuple description of tuples in the file.
+         * @param page_size the page size of the file if it is created. A file created with a page size other than
+         * DEFAULT_PAGE_SIZE starts with a header of FILE_HEADER_SIZE bytes that records it; an existing file keeps the
+         * page size of its header, or DEFAULT_PAGE_SIZE if it has none, so files of the default size have no header.
+         * @throws std::invalid_argument if the page size is not valid (see valid_page_size).
          * @throws std::runtime_error if the file cannot be opened or if the `fstat` system call fails.
          * @note This method calculates the number of pages in the file by dividing the file size (in bytes)
-         * by the `DEFAULT_PAGE_SIZE`.
+         * by the page size.
          */
-        explicit DbFile(const std::string &name, const TupleDesc &td);
+        explicit DbFile(const std::string &name, const TupleDesc &td, size_t page_size = DEFAULT_PAGE_SIZE);
 
         /**
          * @brief closes the file descriptor.
@@ -42,24 +76,100 @@ namespace db {
 
         const std::string &getName() const;
 
+        /**
+         * @brief Get the id the Database interned the name of the file to.
+         */
+        uint32_t getId() const;
+
+        /**
+         * @brief Get the number of bytes of the pages of the file.
+         */
+        size_t getPageSize() const;
+
         const std::vector<size_t> &getReads() const;
 
         const std::vector<size_t> &getWrites() const;
 
+        /**
+         * @brief Access the file with direct I/O (O_DIRECT), bypassing the page cache of the kernel.
+         * @details The pages of the file are then only cached by the BufferPool, whose frames are aligned to
+         * DIRECT_IO_ALIGNMENT. readPage, writePage and writePages copy pages that are not aligned through an aligned
+         * buffer.
+         * @throws std::runtime_error if the file system does not support direct I/O.
+         */
+        void setDirect(bool direct);
+
+        bool isDirect() const;
+
         /**
          * @brief Read a page from the file.
-         * @param page The page to read into.
+         * @note Safe to call from several threads at once, as long as no thread writes the same page.
+         * @param page The page to read into, of at least getPageSize() bytes.
          * @param id The page number of the page to be read. It determines the offset within the file.
+         * @throws std::invalid_argument if the page is too small.
          */
-        void readPage(Page &page, size_t id) const;
+        void readPage(std::span<uint8_t> page, size_t id) const;
 
         /**
          * @brief Write a page to the file.
-         * @param page The page to write.
+         * @param page The page to write, of at least getPageSize() bytes.
          * @param id The page number of the page to which the data will be written.
          * It determines the offset in the file.
+         * @throws std::invalid_argument if the page is too small.
          */
-        void writePage(const Page &page, size_t id) const;
+        void writePage(std::span<const uint8_t> page, size_t id) const;
+
+        /**
+         * @brief Write consecutive pages with a single vectored write.
+         * @param pages The pages to write, in order, of getPageSize() bytes each.
+         * @param first The page number of the first page.
+         * @throws std::runtime_error if the pages could not be written entirely.
+         */
+        void writePages(std::span<const uint8_t *const> pages, size_t first) const;
+
+        /**
+         * @brief Describe the read of a page, to be run in a batch by an IoQueue.
+         * @details The page is zeroed first, so the part past the end of the file reads as zeros. The read is recorded
+         * in getReads() like the reads of readPage.
+         * @param page The page to read into. It must stay valid until the request completed.
+         * @throws std::invalid_argument if the file uses direct I/O and the page is not aligned to DIRECT_IO_ALIGNMENT.
+         * @param id The page number of the page to be read.
+         */
+        IoRequest readRequest(std::span<uint8_t> page, size_t id) const;
+
+        /**
+         * @brief Describe the write of a page, to be run in a batch by an IoQueue.
+         * @details The write is recorded in getWrites() like the writes of writePage.
+         * @param page The page to write. It must stay valid and unmodified until the request completed.
+         * @throws std::invalid_argument if the file uses direct I/O and the page is not aligned to DIRECT_IO_ALIGNMENT.
+         * @param id The page number of the page to which the data will be written.
+         */
+        IoRequest writeRequest(std::span<const uint8_t> page, size_t id) const;
+
+        /**
+         * @brief Map the file read-only, so that scans read its pages in place instead of copying them into the
+         * BufferPool.
+         * @details The pages of the file in the BufferPool are flushed and discarded first. The mapping is advised
+         * for sequential access (MADV_SEQUENTIAL), so the kernel reads ahead of scans. Until unmap(), the tuples of
+         * the file cannot be inserted or deleted. The file must not be in use while it is mapped or unmapped.
+         * @throws std::runtime_error if the file cannot be mapped.
+         */
+        void map();
+
+        /**
+         * @brief Undo map(). Does nothing if the file is not mapped.
+         */
+        void unmap();
+
+        bool isMapped() const;
+
+        /**
+         * @brief Pin a page for reading.
+         * @details The page is read in place if it is in the mapping of the file, and pinned in the BufferPool
+         * otherwise.
+         * @param id The page number.
+         */
+        PageGuard pinForRead(size_t id) const;
 
         virtual void insertTuple(const Tuple &t);
 
@@ -69,6 +179,15 @@ namespace db {
 
         virtual void next(Iterator &it) const;
 
+        /**
+         * @brief Read the next batch of tuples.
+         * @details Replace the contents of the batch with up to BATCH_SIZE tuples starting at the iterator, and advance
+         * the iterator past them. The default implementation reads the tuples one at a time with getTuple and next.
+         * @param it The iterator of the first tuple to read. It equals end() once every tuple has been read.
+         * @param batch The batch to fill. It must have been constructed with the tuple descriptor of this file.
+         */
+        virtual void readBatch(Iterator &it, Batch &batch) const;
+
         virtual Iterator begin() const;
 
         virtual Iterator end() const;
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <db/Query.hpp>
+#include <functional>
+
+namespace db {
+    /// The number of consecutive pages (or leaves of a BTreeFile) a worker scans as one unit of work.
+    constexpr size_t MORSEL_PAGES = 16;
+
+/**
+ * @brief Runs scan pipelines on several threads, one morsel of pages at a time.
+ * @details A scan of a HeapFile or a BTreeFile is split into morsels of MORSEL_PAGES pages. Each worker starts with a
+ * contiguous range of morsels and, once it is exhausted, steals morsels from the front of the ranges of the other
+ * workers, so a slow morsel does not leave the other cores idle. Workers read pages with DbFile::readPage into private
+ * buffers after the file has been flushed, and never touch the BufferPool; results are merged on the calling thread.
+ * Other DbFiles are scanned on the calling thread.
+ * @note The input must not be modified while it is being scanned.
+ */
+    class Executor {
+        size_t workers;
+
+    public:
+        /**
+         * @brief Construct an executor.
+         * @param workers the number of worker threads, or 0 for one per hardware thread
+         */
+        explicit Executor(size_t workers = 0);
+
+        size_t getWorkers() const;
+
+        /**
+         * @brief Push the tuples of a file that satisfy predicates through a task, in parallel.
+         * @details The task is called on the worker threads with batches of the tuples of a morsel, in order within the
+         * morsel. Once every morsel up to a given one is complete, merge is called with it on the calling thread, in
+         * morsel order, so results buffered per morsel can be combined in the order of a sequential scan.
+         * @param file the file to scan
+         * @param pred the predicates the tuples must satisfy, combined with a logical AND
+         * @param task called as task(worker, morsel, batch); it may move the contents out of the batch
+         * @param merge called as merge(morsel) on the calling thread, may be empty
+         * @return the number of morsels
+         * @throws the first exception thrown by a task or by merge, once every worker has stopped
+         */
+        size_t scan(const DbFile &file, const std::vector<FilterPredicate> &pred,
+                    const std::function<void(size_t, size_t, Batch &)> &task,
+                    const std::function<void(size_t)> &merge = {}) const;
+
+        /**
+         * @brief Perform a filter operation in parallel.
+         * @details Same output, in the same order, as db::filter.
+         */
+        void filter(const DbFile &in, DbFile &out, const std::vector<FilterPredicate> &pred) const;
+
+        /**
+         * @brief Perform a filter followed by a projection in parallel.
+         * @details Same output, in the same order, as db::filter followed by db::projection.
+         */
+        void projection(const DbFile &in, DbFile &out, const std::vector<std::string> &field_names,
+                        const std::vector<FilterPredicate> &pred = {}) const;
+
+        /**
+         * @brief Perform an equality join in parallel.
+         * @details The input with fewer pages is the build side. Workers scan it and hash partition its tuples into
+         * buffers of their own, then each partition is loaded into its own hash table by one worker, so no table is
+         * shared while it is written. Workers then scan morsels of the other input and probe the tables, which are only
+         * read from then on, writing the matches into per-morsel buffers that are inserted into out in morsel order.
+         * The output has the same layout as db::join. The build side is held in memory.
+         * @throws std::logic_error if the predicate operation is not EQ
+         */
+        void join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred) const;
+
+        /**
+         * @brief Perform a filter followed by an aggregation in parallel.
+         * @details Every worker aggregates the morsels it scans into its own groups, and the partial groups are merged
+         * once the scan is complete. The groups are emitted in the order db::aggregate emits them. Unlike db::aggregate,
+         * the groups are held in memory.
+         * @throws std::logic_error if there are no aggregates
+         */
+        void aggregate(const DbFile &in, DbFile &out, const GroupBy &agg,
+                       const std::vector<FilterPredicate> &pred = {}) const;
+    };
+} // namespace db
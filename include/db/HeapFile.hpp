@@ -1,22 +1,65 @@
 #pragma once
 
 #include <db/DbFile.hpp>
+#include <vector>
 
 namespace db {
+    /// The suffix of the name of the side file that stores the free-space map of a HeapFile.
+    constexpr const char *FREE_SPACE_MAP_SUFFIX = ".fsm";
+
+/**
+ * @brief A file of tuples in no particular order, stored in HeapPage pages.
+ * @details A free-space map finds a page with a free slot for an insert in constant amortized time: a stack of the pages
+ * that may have a free slot, and a bitmap of the pages on the stack. It is stored in a side file, named after the file
+ * with FREE_SPACE_MAP_SUFFIX, with a byte per page that records whether the page is full. The byte of a page is only
+ * written when the page fills up or a delete frees a slot of a full page, and the side file is loaded when the file is
+ * opened, so no page is read to find one with a free slot. The pages the side file does not record, those of a file
+ * written before it existed, are read from the last one back, and only until one has a free slot. The map is a hint:
+ * an insert checks the page. Like the number of pages, it is not synchronized.
+ */
     class HeapFile : public DbFile {
+        // The side file of the free-space map.
+        int fsm;
+        // The pages that may have a free slot, the most recently freed one on top.
+        std::vector<size_t> free_pages;
+        // Whether each page is in free_pages.
+        std::vector<bool> listed;
+        // The pages the side file did not record when the file was opened and that were not read since, in order.
+        std::vector<size_t> unrecorded;
+
+        bool mapFreeSpace();
+
+        bool addFreePage(size_t page);
+
+        void record(size_t page, bool full);
+
     public:
-        HeapFile(const std::string &name, const TupleDesc &td);
+        /**
+         * @brief Open or create a heap file and load its free-space map.
+         * @details The side file of the map is created if it does not exist, and emptied if the file is.
+         * @throws std::runtime_error if the side file cannot be opened or read.
+         */
+        HeapFile(const std::string &name, const TupleDesc &td, size_t page_size = DEFAULT_PAGE_SIZE);
+
+        /**
+         * @brief Closes the side file of the free-space map.
+         */
+        ~HeapFile() override;
 
         /**
          * @brief Insert a tuple to the database file.
-         * @details Insert a tuple to the first available slot of the last page. If the last page is full, create a new page.
+         * @details Insert a tuple to the first available slot of a page with free space, found with the free-space map:
+         * the page that was last freed by a delete, or the last page. If no page has space, create a new page.
+         * @throws std::runtime_error if the free-space map cannot be written.
          * @param t The tuple to be inserted.
          */
         void insertTuple(const Tuple &t) override;
 
         /**
          * @brief Delete a tuple from the database file.
-         * @details Delete a tuple from the database file by marking the slot unused.
+         * @details Delete a tuple from the database file by marking the slot unused. The page is added to the
+         * free-space map, so the slot is reused by a following insert.
+         * @throws std::runtime_error if the free-space map cannot be written.
          * @param it The iterator that identifies the tuple to be deleted.
          */
         void deleteTuple(const Iterator &it) override;
@@ -37,6 +80,15 @@ namespace db {
          */
         void next(Iterator &it) const override;
 
+        /**
+         * @brief Read the next batch of tuples.
+         * @details Decode the occupied slots of each page directly into the columns of the batch, fetching every page
+         * from the BufferPool once per batch instead of once per tuple.
+         * @param it The iterator of the first tuple to read. It equals end() once every tuple has been read.
+         * @param batch The batch to fill.
+         */
+        void readBatch(Iterator &it, Batch &batch) const override;
+
         /**
          * @brief Get the iterator to the first tuple.
          * @details Get the iterator to the first tuple by finding the first occupied slot.
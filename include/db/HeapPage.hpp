@@ -13,12 +13,12 @@ namespace db {
         /**
          * @brief Wrap a page with a heap page.
          * @details Wrap a page with a heap page by initializing the header and data pointers.
-         * @param page The page to be wrapped.
+         * @param page The page to be wrapped, of the page size of its file.
          * @param td The tuple descriptor of the page.
          * @note header and data should point to locations inside the page buffer. Do not allocate extra memory.
          * @note initialize capacity to the number of slots that can fit in the page.
          */
-        HeapPage(Page &page, const TupleDesc &td);
+        HeapPage(std::span<uint8_t> page, const TupleDesc &td);
 
         /**
          * @brief Get the first occupied slot of the page.
@@ -47,6 +47,11 @@ namespace db {
          */
         void deleteTuple(size_t slot);
 
+        /**
+         * @brief Check if every slot is occupied.
+         */
+        bool full() const;
+
         /**
          * @brief Check if the slot is occupied.
          * @details Check if the slot is empty by examining the header.
@@ -63,6 +68,27 @@ namespace db {
          */
         Tuple getTuple(size_t slot) const;
 
+        /**
+         * @brief Append the tuple at the specified slot to a batch.
+         * @details The fields are copied from the page into the columns of the batch without building a Tuple.
+         * @param slot The slot of the tuple to be read.
+         * @param batch The batch to append to.
+         */
+        void getTuple(size_t slot, Batch &batch) const;
+
+        /**
+         * @brief Get the occupancy bitmap of the page.
+         * @details Slot i is occupied if bit (7 - i % 8) of byte i / 8 is set. The bitmap has (end() + 7) / 8 bytes.
+         */
+        const uint8_t *occupancy() const;
+
+        /**
+         * @brief Get the location of a field in the first slot.
+         * @details Slots are stored back to back, so the field of slot i is i * td.length() bytes past it.
+         * @param index The index of the field.
+         */
+        const uint8_t *field(size_t index) const;
+
         /**
          * @brief Advance the slot to the next occupied slot.
          * @details Advance the slot to the next occupied slot by scanning the header.
@@ -26,10 +26,9 @@ namespace db {
          * `IndexPageHeader::size + 1` page numbers. The keys are sorted in ascending order.
          * The capacity of the page is calculated based on the remaining size of the page.
          *
-         * @param page the page contents
-         * @param key_index the index of the key in the tuple
+         * @param page the page contents, of the page size of the file
          */
-        explicit IndexPage(Page &page);
+        explicit IndexPage(std::span<uint8_t> page);
 
         /**
          * @brief Insert a new key with a corresponding child page number
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <sys/types.h>
+
+namespace db {
+    /// The direction of an IoRequest.
+    enum class IoOp {
+        READ, WRITE
+    };
+
+    /// A read or write of a range of a file, and its result once it completed.
+    struct IoRequest {
+        IoOp op;
+        int fd;
+        void *data;
+        size_t length;
+        off_t offset;
+        /// The number of bytes transferred, or minus the errno of the failure.
+        ssize_t result = 0;
+    };
+
+/**
+ * @brief Runs batches of reads and writes.
+ * @details When the library is built with DB_IO_URING and the kernel allows it, a batch is queued in the submission
+ * ring of an io_uring and handed to the kernel with a single system call, which then performs the transfers
+ * concurrently; the queue only waits for their completions. Otherwise, or if the ring cannot be set up at runtime or
+ * does not support reads and writes (before Linux 5.6), the requests are performed one after the other with pread and
+ * pwrite.
+ * @note run() may be called from several threads, the batches are run one at a time.
+ */
+    class IoQueue {
+        std::mutex mutex;
+        int ring_fd = -1;
+        unsigned entries = 0;
+        // The mappings of the rings and of the submission queue entries.
+        void *sq_ring = nullptr;
+        size_t sq_ring_size = 0;
+        void *cq_ring = nullptr;
+        size_t cq_ring_size = 0;
+        void *sqes = nullptr;
+        size_t sqes_size = 0;
+        // Pointers into the rings, see io_uring_setup(2).
+        unsigned *sq_head = nullptr;
+        unsigned *sq_tail = nullptr;
+        unsigned *sq_mask = nullptr;
+        unsigned *sq_array = nullptr;
+        unsigned *cq_head = nullptr;
+        unsigned *cq_tail = nullptr;
+        unsigned *cq_mask = nullptr;
+        void *cqes = nullptr;
+
+        void runSync(std::span<IoRequest> requests);
+
+        void runRing(std::span<IoRequest> requests);
+
+    public:
+        /**
+         * @param depth the number of requests in flight at once
+         */
+        explicit IoQueue(unsigned depth = 64);
+
+        ~IoQueue();
+
+        IoQueue(const IoQueue &) = delete;
+
+        IoQueue &operator=(const IoQueue &) = delete;
+
+        /**
+         * @brief Whether batches are submitted to an io_uring rather than run synchronously.
+         */
+        bool isAsync() const;
+
+        /**
+         * @brief Perform every request of a batch and set their results.
+         * @throws std::runtime_error if the batch cannot be submitted. The requests the kernel already took are
+         * completed before, so their buffers can be reused. The failure of a single request is reported in its result.
+         */
+        void run(std::span<IoRequest> requests);
+    };
+} // namespace db
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <db/Batch.hpp>
+#include <db/Query.hpp>
+#include <cstdint>
+
+namespace db {
+/**
+ * @brief The instruction sets a predicate kernel may use.
+ * @details SCALAR works everywhere. SSE2 and AVX2 are only available on x86 processors that support them.
+ */
+    enum class SimdLevel {
+        SCALAR, SSE2, AVX2
+    };
+
+/**
+ * @brief Get the best instruction set supported by the processor.
+ */
+    SimdLevel detect_simd_level();
+
+/**
+ * @brief Get the instruction set currently used by the predicate kernels.
+ * @details Defaults to detect_simd_level().
+ */
+    SimdLevel simd_level();
+
+/**
+ * @brief Choose the instruction set used by the predicate kernels.
+ * @param level the requested instruction set. It is lowered to detect_simd_level() if the processor lacks it.
+ * @return the instruction set that will be used.
+ */
+    SimdLevel set_simd_level(SimdLevel level);
+
+/**
+ * @brief Evaluate a comparison on an INT column laid out at a fixed stride.
+ * @details Slot i holds its value at base + i * stride. The result for slot i is ANDed into bit (7 - i % 8) of
+ * mask[i / 8], the same layout as the HeapPage header, so the mask can start as a copy of the occupancy bitmap and
+ * several predicates can be applied in turn. Bits of slots at or past n in the last byte are cleared.
+ * @param base the address of the value of slot 0
+ * @param stride the distance in bytes between the values of consecutive slots
+ * @param n the number of slots
+ * @param op the comparison, evaluated as value_of_slot op value
+ * @param value the constant to compare with
+ * @param mask the selection bitmask of (n + 7) / 8 bytes
+ */
+    void select_int(const uint8_t *base, size_t stride, size_t n, PredicateOp op, int value, uint8_t *mask);
+
+/**
+ * @brief Evaluate a comparison on a DOUBLE column laid out at a fixed stride.
+ * @details Same as select_int. Comparisons with NaN behave like the C++ operators: only NE is true.
+ */
+    void select_double(const uint8_t *base, size_t stride, size_t n, PredicateOp op, double value, uint8_t *mask);
+
+/**
+ * @brief Evaluate a comparison on a column of a batch.
+ * @details Entry i of the selection is cleared if row i does not satisfy op against value. Each operation is a
+ * branch-free loop over the primitive array of the column. A value of another type than the column matches no row.
+ * @param column the column to compare
+ * @param op the comparison, evaluated as value_of_row op value
+ * @param value the constant to compare with
+ * @param selection one entry per row of the column
+ */
+    void select_column(const column_t &column, PredicateOp op, const field_t &value, std::vector<uint8_t> &selection);
+} // namespace db
@@ -29,11 +29,11 @@ namespace db {
          * @details The provided page has a header of type LeafPageHeader, followed by a sequence of tuples.
          * The capacity of the page is calculated based on the remaining size of the page and the size of the tuples.
          *
-         * @param page the page contents
+         * @param page the page contents, of the page size of the file
          * @param td the tuple descriptor
          * @param key_index the index of the key in the tuple
          */
-        LeafPage(Page &page, const TupleDesc &td, size_t key_index);
+        LeafPage(std::span<uint8_t> page, const TupleDesc &td, size_t key_index);
 
         /**
          * @brief Insert a tuple into the page
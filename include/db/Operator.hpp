@@ -0,0 +1,235 @@
+#pragma once
+
+#include <db/Query.hpp>
+#include <db/TempFile.hpp>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+namespace db {
+/**
+ * @brief A node of a query plan that produces tuples in batches.
+ * @details Operators are composed into a tree and pulled from the root: open() prepares the operator and its inputs,
+ * each call to next() produces the following batch, and close() releases the inputs. Tuples stream from one operator to
+ * the next without being written to an intermediate DbFile; only pipeline breakers (the build side of a join, an
+ * aggregation) hold state, and they spill to temporary files when it exceeds their memory budget.
+ */
+    class Operator {
+    public:
+        virtual ~Operator() = default;
+
+        /**
+         * @brief Get the tuple descriptor of the produced tuples.
+         */
+        virtual const TupleDesc &getTupleDesc() const = 0;
+
+        /**
+         * @brief Prepare the operator to produce tuples from the beginning.
+         */
+        virtual void open() = 0;
+
+        /**
+         * @brief Produce the next batch of tuples.
+         * @param batch Replaced with the next tuples, with one column per field of getTupleDesc().
+         * @return True if the batch holds at least one tuple, false once every tuple has been produced.
+         */
+        virtual bool next(Batch &batch) = 0;
+
+        /**
+         * @brief Release the state of the operator and close its inputs.
+         */
+        virtual void close() = 0;
+    };
+
+/**
+ * @brief Read the tuples of a DbFile, optionally keeping only those that satisfy predicates.
+ * @details When the file is a HeapFile and every predicate compares an INT or DOUBLE field with a value of the same
+ * type, the predicates are evaluated on the page bytes with the SIMD kernels before any tuple is decoded.
+ */
+    class ScanOperator : public Operator {
+        const DbFile &file;
+        std::vector<FilterPredicate> pred;
+        std::vector<size_t> indices;
+        bool kernels;
+        std::optional<Iterator> it;
+        size_t page = 0;
+        size_t slot = 0;
+        std::vector<uint8_t> mask;
+
+        bool nextPages(Batch &batch);
+
+    public:
+        /**
+         * @param file the file to read
+         * @param pred the predicates the tuples must satisfy, combined with a logical AND
+         */
+        explicit ScanOperator(const DbFile &file, std::vector<FilterPredicate> pred = {});
+
+        const TupleDesc &getTupleDesc() const override;
+
+        void open() override;
+
+        bool next(Batch &batch) override;
+
+        void close() override;
+    };
+
+/**
+ * @brief Keep the tuples of the input that satisfy predicates, combined with a logical AND.
+ * @details Each predicate is evaluated as a tight loop over one column of the batch.
+ */
+    class FilterOperator : public Operator {
+        std::unique_ptr<Operator> child;
+        std::vector<FilterPredicate> pred;
+        std::vector<size_t> indices;
+
+    public:
+        FilterOperator(std::unique_ptr<Operator> child, std::vector<FilterPredicate> pred);
+
+        const TupleDesc &getTupleDesc() const override;
+
+        void open() override;
+
+        bool next(Batch &batch) override;
+
+        void close() override;
+    };
+
+/**
+ * @brief Keep a subset of the fields of the input, in the given order.
+ */
+    class ProjectOperator : public Operator {
+        std::unique_ptr<Operator> child;
+        std::vector<size_t> indices;
+        TupleDesc td;
+
+    public:
+        ProjectOperator(std::unique_ptr<Operator> child, const std::vector<std::string> &field_names);
+
+        const TupleDesc &getTupleDesc() const override;
+
+        void open() override;
+
+        bool next(Batch &batch) override;
+
+        void close() override;
+    };
+
+/**
+ * @brief Equality join through an in-memory hash table.
+ * @details open() loads the build input into a hash table keyed on its join field, then next() streams the probe input
+ * against it. The output has the layout of join: the left fields followed by the right fields without the right join
+ * field. Right fields whose name is also a left field name get a numeric suffix.
+ */
+    class HashJoinOperator : public Operator {
+        std::unique_ptr<Operator> left;
+        std::unique_ptr<Operator> right;
+        bool buildLeft;
+        size_t lidx;
+        size_t ridx;
+        TupleDesc td;
+        std::vector<Tuple> rows;
+        std::unordered_multimap<field_t, size_t> table;
+        Batch probe;
+        size_t row = 0;
+        std::unordered_multimap<field_t, size_t>::const_iterator match;
+        std::unordered_multimap<field_t, size_t>::const_iterator matchEnd;
+
+    public:
+        /**
+         * @param left the left input
+         * @param right the right input
+         * @param pred the join predicate
+         * @param buildLeft whether the left input is loaded into the hash table instead of the right one
+         * @throws std::logic_error if the predicate operation is not EQ
+         */
+        HashJoinOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right, const JoinPredicate &pred,
+                         bool buildLeft = false);
+
+        const TupleDesc &getTupleDesc() const override;
+
+        void open() override;
+
+        bool next(Batch &batch) override;
+
+        void close() override;
+    };
+
+/**
+ * @brief Join with any predicate by comparing every left tuple with every right tuple.
+ * @details open() loads the right input in memory, then next() streams the left input against it. The output layout is
+ * the same as HashJoinOperator.
+ */
+    class NestedLoopJoinOperator : public Operator {
+        std::unique_ptr<Operator> left;
+        std::unique_ptr<Operator> right;
+        PredicateOp op;
+        size_t lidx;
+        size_t ridx;
+        TupleDesc td;
+        std::vector<Tuple> rows;
+        Batch probe;
+        size_t row = 0;
+        size_t pos = 0;
+
+    public:
+        NestedLoopJoinOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right,
+                               const JoinPredicate &pred);
+
+        const TupleDesc &getTupleDesc() const override;
+
+        void open() override;
+
+        bool next(Batch &batch) override;
+
+        void close() override;
+    };
+
+/**
+ * @brief Several aggregates over the same grouping.
+ * @details open() consumes the input with one accumulator per group and aggregate. Once the groups held in memory
+ * reach memory_pages pages worth of output tuples, tuples of new groups are hash partitioned into temporary files,
+ * which next() aggregates one at a time after the groups in memory. The output tuples contain the group fields followed
+ * by one field per aggregate, named like "sum(price)".
+ */
+    class AggregateOperator : public Operator {
+        std::unique_ptr<Operator> child;
+        std::vector<size_t> grpIdx;
+        std::vector<std::pair<AggregateOp, size_t>> aggs;
+        size_t maxGroups;
+        size_t fanOut;
+        size_t depth;
+        TupleDesc td;
+        std::vector<Tuple> results;
+        size_t emitted = 0;
+        std::vector<TempFile> spill;
+        size_t part = 0;
+        std::unique_ptr<AggregateOperator> partAgg;
+
+        AggregateOperator(std::unique_ptr<Operator> child, std::vector<size_t> grpIdx,
+                          std::vector<std::pair<AggregateOp, size_t>> aggs, size_t maxGroups, size_t fanOut,
+                          size_t depth);
+
+        void describe();
+
+    public:
+        /**
+         * @param child the input
+         * @param agg the groups and aggregates
+         * @param memory_pages the number of pages of groups held in memory
+         * @param page_size the size of these pages, usually the page size of the file the input is read from
+         * @throws std::invalid_argument if memory_pages is zero
+         * @throws std::logic_error if there are no aggregates
+         */
+        AggregateOperator(std::unique_ptr<Operator> child, const GroupBy &agg,
+                          size_t memory_pages = DEFAULT_MEMORY_PAGES, size_t page_size = DEFAULT_PAGE_SIZE);
+
+        const TupleDesc &getTupleDesc() const override;
+
+        void open() override;
+
+        bool next(Batch &batch) override;
+
+        void close() override;
+    };
+} // namespace db
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <db/types.hpp>
+#include <optional>
+#include <vector>
+
+namespace db {
+/**
+ * @brief A map from PageId to a slot of the BufferPool, with open addressing and linear probing.
+ * @details The entries are stored inline in a power-of-two array that is kept at most half full. Erasing an entry
+ * shifts the entries of the same probe sequence back into the hole, so lookups never skip over deleted entries.
+ * The table is not synchronized.
+ */
+    class PageTable {
+        static constexpr size_t EMPTY = SIZE_MAX;
+
+        struct Entry {
+            PageId pid;
+            size_t slot = EMPTY;
+        };
+
+        std::vector<Entry> entries;
+        size_t count = 0;
+
+        size_t home(const PageId &pid) const;
+
+        void grow();
+
+    public:
+        /**
+         * @param capacity the number of entries the table holds before it grows
+         */
+        explicit PageTable(size_t capacity = 8);
+
+        /**
+         * @brief Get the slot of a page, if it is in the table.
+         */
+        std::optional<size_t> find(const PageId &pid) const;
+
+        /**
+         * @brief Add a page that is not in the table.
+         */
+        void insert(const PageId &pid, size_t slot);
+
+        /**
+         * @brief Remove a page.
+         * @return True if the page was in the table.
+         */
+        bool erase(const PageId &pid);
+
+        size_t size() const;
+
+        /**
+         * @brief Call f(pid, slot) for every entry.
+         */
+        template<typename F>
+        void forEach(const F &f) const {
+            for (const auto &entry: entries) {
+                if (entry.slot != EMPTY) f(entry.pid, entry.slot);
+            }
+        }
+    };
+} // namespace db
@@ -5,6 +5,8 @@
 #include <vector>
 
 namespace db {
+    /// The default number of pages an operator may hold in memory before it spills to temporary files.
+    constexpr size_t DEFAULT_MEMORY_PAGES = 32;
 
 /**
  * @brief The operation of a predicate.
@@ -68,6 +70,36 @@ namespace db {
         std::string field;
     };
 
+/**
+ * @brief One aggregate of a GroupBy.
+ * @details The op is the operation to perform.
+ *   The field is the field to summarize.
+ */
+    struct AggregateField {
+        AggregateOp op;
+        std::string field;
+    };
+
+/**
+ * @brief Several aggregates over the same grouping, computed in a single scan.
+ * @details The groups are the fields to group by, possibly none.
+ *   The aggregates are the (op, field) pairs to compute for each group.
+ *   The output tuples contain the group fields followed by one field per aggregate, in the order given.
+ */
+    struct GroupBy {
+        std::vector<std::string> groups;
+        std::vector<AggregateField> aggregates;
+    };
+
+/**
+ * @brief Compare two fields.
+ * @param lhs The left operand.
+ * @param rhs The right operand.
+ * @param op The comparison to perform.
+ * @return lhs op rhs, or false if the fields have different types.
+ */
+    bool compare(const field_t &lhs, const field_t &rhs, PredicateOp op);
+
 /**
  * @brief Perform a projection operation.
  * @details A projection operation selects a subset of fields from the input table.
@@ -98,10 +130,92 @@ namespace db {
  * @param right The right table.
  * @param out The output table.
  * @param pred The join predicates.
+ * @param memory_pages The number of pages the join may hold in memory.
  * @note When performing an equality join do not keep the join field of the right table in the output.
  * @note Keep in mind that the bufferpool has a limited size.
+ * @note Equality joins are executed with grace_hash_join, which runs in memory when the smaller input fits the budget.
+ *   If both inputs are BTreeFiles keyed on their join fields, equality joins use sort_merge_join instead.
+ *   If only the right input is such a BTreeFile and the left input has fewer tuples than the right input has pages,
+ *   equality joins use index_nested_loop_join.
+ * @note Range joins (LT, LE, GT, GE) are executed with sort_merge_join, and NE joins with block_nested_loop_join
+ *   using memory_pages as the block size.
+ */
+    void join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred,
+              size_t memory_pages = DEFAULT_MEMORY_PAGES);
+
+/**
+ * @brief Perform an equality join with a build-side/probe-side hash join.
+ * @details The input with fewer pages is loaded into an in-memory hash table keyed on its join field,
+ *   then the other input is scanned once and probed against it. Each input is read exactly once.
+ *   The output has the same layout as join: the left fields followed by the right fields without the right join field.
+ * @param left The left table.
+ * @param right The right table.
+ * @param out The output table.
+ * @param pred The join predicate.
+ * @throws std::logic_error if the predicate operation is not EQ.
  */
-    void join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred);
+    void hash_join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred);
+
+/**
+ * @brief Perform an equality join with a partitioned (Grace) hash join.
+ * @details If the smaller input does not fit in memory_pages, both inputs are hashed on their join fields into the same
+ *   number of temporary HeapFile partitions. Matching partition pairs are then joined with hash_join, and partitions
+ *   that are still too large are partitioned again with a different hash. The temporary files are registered with the
+ *   Database while in use and deleted afterwards.
+ * @param left The left table.
+ * @param right The right table.
+ * @param out The output table.
+ * @param pred The join predicate.
+ * @param memory_pages The number of pages the join may hold in memory.
+ * @throws std::logic_error if the predicate operation is not EQ.
+ * @throws std::invalid_argument if memory_pages is zero.
+ */
+    void grace_hash_join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred,
+                         size_t memory_pages = DEFAULT_MEMORY_PAGES);
+
+/**
+ * @brief Perform a join with a sort-merge join.
+ * @details Both inputs are scanned in ascending order of their join fields and merged in a single pass.
+ *   A BTreeFile keyed on its join field is already in order and is read directly; any other input is first sorted
+ *   with an external merge sort into a temporary HeapFile, using runs of memory_pages pages.
+ *   Range predicates (LT, LE, GT, GE) emit, for each left tuple, the prefix or suffix of the right input that matches.
+ * @param left The left table.
+ * @param right The right table.
+ * @param out The output table.
+ * @param pred The join predicate.
+ * @param memory_pages The number of pages the external sort may hold in memory.
+ * @throws std::logic_error if the predicate operation is NE.
+ * @throws std::invalid_argument if memory_pages is zero.
+ */
+    void sort_merge_join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred,
+                         size_t memory_pages = DEFAULT_MEMORY_PAGES);
+
+/**
+ * @brief Perform a join with a block nested-loop join.
+ * @details The tuples of block_pages left pages are held in memory at a time and the right input is scanned once per
+ *   block, comparing each right tuple against the whole block. Any predicate operation is supported.
+ * @param left The left table.
+ * @param right The right table.
+ * @param out The output table.
+ * @param pred The join predicate.
+ * @param block_pages The number of left pages per block.
+ * @throws std::invalid_argument if block_pages is zero.
+ */
+    void block_nested_loop_join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred,
+                                size_t block_pages = DEFAULT_MEMORY_PAGES);
+
+/**
+ * @brief Perform a join with an index nested-loop join.
+ * @details The right input must be a BTreeFile keyed on its join field. For every left tuple the tree is searched with
+ *   BTreeFile::seek and only the matching range of keys is read, instead of scanning the whole right input.
+ * @param left The left (outer) table.
+ * @param right The right (inner) table.
+ * @param out The output table.
+ * @param pred The join predicate.
+ * @throws std::logic_error if the right input is not a BTreeFile keyed on its join field, if the left join field
+ *   is not an INT, or if the predicate operation is NE.
+ */
+    void index_nested_loop_join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred);
 
 /**
  * @brief Perform an aggregate operation.
@@ -112,8 +226,28 @@ namespace db {
  * @param in The input table.
  * @param out The output table.
  * @param agg The aggregate operation.
+ * @param memory_pages The number of pages the group table may hold in memory, measured in output tuples.
  * @note The computed value should have the same type as the field being aggregated with the exception of AVG which should return a double.
+ * @note Once the group table is full, rows of new groups are hashed on the group field into temporary HeapFile
+ *   partitions, which are aggregated after the in-memory groups are emitted. The output tuples are the same, but
+ *   spilled groups appear after the in-memory ones.
+ * @throws std::invalid_argument if memory_pages is zero.
+ */
+    void aggregate(const DbFile &in, DbFile &out, const Aggregate &agg, size_t memory_pages = DEFAULT_MEMORY_PAGES);
+
+/**
+ * @brief Perform several aggregate operations over a multi-field grouping in one pass.
+ * @details Every aggregate of every group is accumulated while scanning the input once.
+ *   If there are no group fields, the result is a single tuple with one field per aggregate.
+ *   Otherwise, the result has one tuple per unique combination of group fields.
+ *   Groups that do not fit in memory_pages are spilled the same way as for a single aggregate.
+ * @param in The input table.
+ * @param out The output table.
+ * @param agg The grouping and the aggregates to compute.
+ * @param memory_pages The number of pages the group table may hold in memory, measured in output tuples.
+ * @throws std::logic_error if agg has no aggregates.
+ * @throws std::invalid_argument if memory_pages is zero.
  */
-    void aggregate(const DbFile &in, DbFile &out, const Aggregate &agg);
+    void aggregate(const DbFile &in, DbFile &out, const GroupBy &agg, size_t memory_pages = DEFAULT_MEMORY_PAGES);
 
 } // namespace db
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <db/types.hpp>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace db {
+    /// The replacement policies a BufferPool can be constructed with.
+    enum class Replacement {
+        LRU, CLOCK, TWO_Q
+    };
+
+/**
+ * @brief Decides which slot of a BufferPool is evicted next.
+ * @details A policy tracks the slots that hold a page. The BufferPool reports each access to a slot, adds a slot once a
+ * page is loaded in it, and removes slots whose page is discarded. evict() picks a tracked slot and stops tracking it,
+ * so no other thread can pick it until it is restored or filled again. All methods may be called from several threads.
+ */
+    class ReplacementPolicy {
+    public:
+        virtual ~ReplacementPolicy() = default;
+
+        /**
+         * @brief Start tracking a slot that was just filled.
+         * @param slot the slot
+         * @param pid the page held in the slot
+         */
+        virtual void insert(size_t slot, const PageId &pid) = 0;
+
+        /**
+         * @brief Record an access to a slot. Accesses to slots that are not tracked are ignored.
+         */
+        virtual void access(size_t slot) = 0;
+
+        /**
+         * @brief Stop tracking a slot whose page was discarded.
+         * @return True if the slot was tracked, false if it was taken by evict() in the meantime.
+         */
+        virtual bool remove(size_t slot) = 0;
+
+        /**
+         * @brief Pick a slot to evict and stop tracking it.
+         * @param evictable whether a slot may be evicted (is not pinned)
+         * @return The slot, or nothing if no tracked slot is evictable.
+         */
+        virtual std::optional<size_t> evict(const std::function<bool(size_t)> &evictable) = 0;
+
+        /**
+         * @brief Track again a slot returned by evict() whose page could not be evicted after all, because it was
+         * pinned or modified meanwhile or could not be written back. Undoes what evict() recorded about the page.
+         */
+        virtual void restore(size_t slot) = 0;
+
+        /**
+         * @brief Forget what is remembered about the evicted pages of a file that was discarded, so that its id can be
+         * given to another file. Policies that remember nothing about evicted pages have nothing to do.
+         */
+        virtual void forgetFile(uint32_t) {}
+    };
+
+/**
+ * @brief A doubly linked list of slots threaded through arrays indexed by slot.
+ * @details Moving a slot within or between lists neither allocates nor hashes. The list is not synchronized.
+ */
+    class SlotList {
+        // prev and next have one entry per slot plus a sentinel at index linked.size().
+        std::vector<size_t> prev;
+        std::vector<size_t> next;
+        std::vector<bool> linked;
+        size_t count = 0;
+
+    public:
+        explicit SlotList(size_t slots);
+
+        /**
+         * @brief Insert a slot that is not in the list at the front.
+         */
+        void push_front(size_t slot);
+
+        /**
+         * @brief Remove a slot that is in the list.
+         */
+        void erase(size_t slot);
+
+        bool contains(size_t slot) const;
+
+        size_t size() const;
+
+        /**
+         * @brief Find the slot closest to the back that satisfies a predicate.
+         */
+        std::optional<size_t> find_back(const std::function<bool(size_t)> &pred) const;
+    };
+
+/**
+ * @brief Evicts the least recently used slot.
+ * @details An access moves the slot to the front of a SlotList under a mutex.
+ */
+    class LRUPolicy : public ReplacementPolicy {
+        std::mutex mutex;
+        SlotList list;
+
+    public:
+        explicit LRUPolicy(size_t slots);
+
+        void insert(size_t slot, const PageId &pid) override;
+
+        void access(size_t slot) override;
+
+        bool remove(size_t slot) override;
+
+        std::optional<size_t> evict(const std::function<bool(size_t)> &evictable) override;
+
+        void restore(size_t slot) override;
+    };
+
+/**
+ * @brief Second chance: a hand sweeps the slots in order and evicts the first one not referenced since its last pass.
+ * @details An access only sets the reference bit of the slot, without taking a lock. The hand clears reference bits as
+ * it passes them; only evict(), insert() and remove() lock.
+ */
+    class ClockPolicy : public ReplacementPolicy {
+        std::mutex mutex;
+        std::vector<std::atomic<bool>> referenced;
+        std::vector<bool> tracked;
+        size_t hand = 0;
+
+    public:
+        explicit ClockPolicy(size_t slots);
+
+        void insert(size_t slot, const PageId &pid) override;
+
+        void access(size_t slot) override;
+
+        bool remove(size_t slot) override;
+
+        std::optional<size_t> evict(const std::function<bool(size_t)> &evictable) override;
+
+        void restore(size_t slot) override;
+    };
+
+/**
+ * @brief The 2Q policy of Johnson and Shasha, which keeps a sequential scan from flushing the pages that are reused.
+ * @details Pages read for the first time enter A1in, a FIFO queue that is not reordered by accesses. When A1in holds
+ * more than a quarter of the slots, its oldest page is evicted and its id is remembered in A1out, a FIFO queue of page
+ * ids as long as half the pool. A page read again while it is remembered in A1out is reused and enters Am, an LRU list,
+ * which is only evicted from while A1in is small. A scan thus cycles through A1in and leaves Am alone.
+ */
+    class TwoQueuePolicy : public ReplacementPolicy {
+        std::mutex mutex;
+        SlotList a1in;
+        SlotList am;
+        std::vector<PageId> pages;
+        // Whether the slot last taken by evict() was in Am rather than A1in.
+        std::vector<bool> evicted_from_am;
+        std::list<PageId> a1out;
+        std::unordered_map<PageId, std::list<PageId>::iterator, std::hash<const PageId>> ghosts;
+        size_t kin;
+        size_t kout;
+
+        void forget(size_t slot);
+
+    public:
+        explicit TwoQueuePolicy(size_t slots);
+
+        void insert(size_t slot, const PageId &pid) override;
+
+        void access(size_t slot) override;
+
+        bool remove(size_t slot) override;
+
+        std::optional<size_t> evict(const std::function<bool(size_t)> &evictable) override;
+
+        void restore(size_t slot) override;
+
+        void forgetFile(uint32_t file) override;
+    };
+
+/**
+ * @brief Create a replacement policy for a pool of the given number of slots.
+ */
+    std::unique_ptr<ReplacementPolicy> make_policy(Replacement replacement, size_t slots);
+} // namespace db
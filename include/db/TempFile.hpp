@@ -0,0 +1,51 @@
+#pragma once
+
+#include <db/DbFile.hpp>
+
+namespace db {
+    /// Hash partitions are split again with a new seed while they exceed the budget, up to this depth.
+    /// Deeper partitions are skewed on a few keys and would not shrink further.
+    constexpr size_t MAX_PARTITION_DEPTH = 3;
+
+/**
+ * @brief A HeapFile registered with the Database for the lifetime of an operator.
+ * @details Operators that spill create their partitions and sorted runs as temporary files. On destruction the file is
+ * dropped from the BufferPool, removed from the Database and deleted from disk, with its free-space map.
+ */
+    class TempFile {
+        std::string name;
+
+    public:
+        /**
+         * @brief Create and register an empty temporary HeapFile.
+         * @param tag a prefix of the file name describing the operator
+         * @param td the tuple descriptor of the file
+         */
+        TempFile(const std::string &tag, const TupleDesc &td);
+
+        ~TempFile();
+
+        TempFile(const TempFile &) = delete;
+
+        TempFile &operator=(const TempFile &) = delete;
+
+        TempFile(TempFile &&other) noexcept;
+
+        DbFile &file() const;
+    };
+
+/**
+ * @brief Map a key hash to one of n partitions.
+ * @param hash the hash of the key
+ * @param seed changes the mapping for each level of recursive partitioning
+ * @param n the number of partitions
+ */
+    size_t partition_of(size_t hash, size_t seed, size_t n);
+
+/**
+ * @brief Get the number of tuples that fit in a heap page (one header bit per slot).
+ * @param td the tuple descriptor of the tuples
+ * @param page_size the size of the page, the page size of the file the tuples are counted in
+ */
+    size_t tuples_per_page(const TupleDesc &td, size_t page_size);
+} // namespace db
@@ -25,6 +25,7 @@ namespace db {
         std::vector<type_t> types;
         std::vector<size_t> offsets;
         std::unordered_map<std::string, size_t> name_to_index;
+        std::vector<std::string> names;
 
     public:
         TupleDesc() = default;
@@ -64,6 +65,20 @@ namespace db {
          */
         size_t index_of(const std::string &name) const;
 
+        /**
+         * @brief Get the type of the field
+         * @param index the index of the field
+         * @return the type of the field
+         */
+        type_t type_of(size_t index) const;
+
+        /**
+         * @brief Get the name of the field
+         * @param index the index of the field
+         * @return the name of the field
+         */
+        const std::string &name_of(size_t index) const;
+
         /**
          * @brief Get the number of fields in the TupleDesc
          * @return the number of fields in the TupleDesc
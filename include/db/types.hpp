@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <span>
 #include <string>
 #include <utility>
 #include <variant>
@@ -17,22 +18,53 @@ namespace db {
 
     using field_t = std::variant<int, double, std::string>;
 
+    /// The file id of the names of no file in the Database. It matches no page of the BufferPool.
+    constexpr uint32_t NO_FILE = UINT32_MAX;
+
+/**
+ * @brief Identifies a page: the id of its file and its page number within the file.
+ * @details File names are interned to small integer ids by the Database, so a PageId is a trivially copyable 64-bit key.
+ */
     struct PageId {
-        std::string file;
-        size_t page;
+        uint32_t file = 0;
+        uint32_t page = 0;
 
     public:
+        PageId() = default;
+
+        PageId(uint32_t file, size_t page) : file(file), page(static_cast<uint32_t>(page)) {}
+
+        /**
+         * @brief Identify a page by the name of its file, using the id Database::getId returns for it.
+         */
+        PageId(const std::string &file, size_t page);
+
         bool operator==(const PageId &) const = default;
     };
 
     constexpr size_t DEFAULT_PAGE_SIZE = 4096;
 
+    /// The largest page size of a file. Page sizes are powers of two from DEFAULT_PAGE_SIZE to MAX_PAGE_SIZE.
+    constexpr size_t MAX_PAGE_SIZE = 64 << 10;
+
     using Page = std::array<uint8_t, DEFAULT_PAGE_SIZE>;
+
+    /// Whether a size is a valid page size.
+    constexpr bool valid_page_size(size_t size) {
+        return size >= DEFAULT_PAGE_SIZE && size <= MAX_PAGE_SIZE && (size & (size - 1)) == 0;
+    }
 } // namespace db
 
 template<>
 struct std::hash<const db::PageId> {
     std::size_t operator()(const db::PageId &r) const {
-        return std::hash<std::string>()(r.file) ^ std::hash<size_t>()(r.page);
+        // The finalizer of MurmurHash3, so that neighbouring pages spread over the whole range.
+        uint64_t h = static_cast<uint64_t>(r.file) << 32 | r.page;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
     }
 };
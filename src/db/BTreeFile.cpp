@@ -3,28 +3,40 @@
 #include <db/Database.hpp>
 #include <db/IndexPage.hpp>
 #include <db/LeafPage.hpp>
+#include <optional>
 #include <stdexcept>
 
 using namespace db;
 
-BTreeFile::BTreeFile(const std::string &name, const TupleDesc &td, size_t key_index)
-        : DbFile(name, td), key_index(key_index) {}
+// Follows the chain of leaves, which ends with a pointer back to the root, page 0.
+static std::optional<size_t> nextLeaf(std::span<const uint8_t> page) {
+    LeafPageHeader header;
+    std::memcpy(&header, page.data(), sizeof(header));
+    if (header.next_leaf == 0) return std::nullopt;
+    return header.next_leaf;
+}
+
+BTreeFile::BTreeFile(const std::string &name, const TupleDesc &td, size_t key_index, size_t page_size)
+        : DbFile(name, td, page_size), key_index(key_index) {}
+
+size_t BTreeFile::getKeyIndex() const { return key_index; }
 
 void BTreeFile::insertTuple(const Tuple &t) {
     // TODO pa2
+    checkWritable();
     std::vector<size_t> path;
     BufferPool &bufferPool = getDatabase().getBufferPool();
-    PageId pid{name, root_id};
+    PageId pid{id, root_id};
 
-    Page &root_page = bufferPool.getPage(pid);
+    std::span<uint8_t> root_page = bufferPool.getPageBytes(pid);
     IndexPage root(root_page);
     if (root.header->size == 0 && root.children[0] != 1) {
-        bufferPool.markDirty({name, root_id});
+        bufferPool.markDirty({id, root_id});
         pid.page = numPages++;
         root.children[0] = pid.page;
     } else {
         while (true) {
-            Page &page = bufferPool.getPage(pid);
+            std::span<uint8_t> page = bufferPool.getPageBytes(pid);
             IndexPage node(page);
             auto pos = std::lower_bound(node.keys, node.keys + node.header->size,
                                         std::get<int>(t.get_field(key_index)));
@@ -37,7 +49,7 @@ void BTreeFile::insertTuple(const Tuple &t) {
         }
     }
 
-    Page &page = bufferPool.getPage(pid);
+    std::span<uint8_t> page = bufferPool.getPageBytes(pid);
     bufferPool.markDirty(pid);
     LeafPage leaf(page, td, key_index);
     if (!leaf.insertTuple(t)) {
@@ -45,7 +57,7 @@ void BTreeFile::insertTuple(const Tuple &t) {
     }
 
     pid.page = numPages++;
-    Page &new_leaf_page = bufferPool.getPage(pid);
+    std::span<uint8_t> new_leaf_page = bufferPool.getPageBytes(pid);
     bufferPool.markDirty(pid);
     LeafPage new_leaf(new_leaf_page, td, key_index);
     int new_key = leaf.split(new_leaf);
@@ -56,7 +68,7 @@ void BTreeFile::insertTuple(const Tuple &t) {
         size_t parent_id = path.back();
         path.pop_back();
         pid.page = parent_id;
-        Page &parent_page = bufferPool.getPage(pid);
+        std::span<uint8_t> parent_page = bufferPool.getPageBytes(pid);
         bufferPool.markDirty(pid);
         IndexPage parent(parent_page);
         if (!parent.insert(new_key, new_child)) {
@@ -64,26 +76,26 @@ void BTreeFile::insertTuple(const Tuple &t) {
         }
 
         pid.page = numPages++;
-        Page &new_internal_page = bufferPool.getPage(pid);
+        std::span<uint8_t> new_internal_page = bufferPool.getPageBytes(pid);
         bufferPool.markDirty(pid);
         IndexPage new_internal(new_internal_page);
         new_key = parent.split(new_internal);
         new_child = pid.page;
     }
 
-    bufferPool.markDirty({name, root_id});
+    bufferPool.markDirty({id, root_id});
     if (!root.insert(new_key, new_child)) {
         return;
     }
     pid.page = numPages++;
-    Page &new_child1 = bufferPool.getPage(pid);
+    std::span<uint8_t> new_child1 = bufferPool.getPageBytes(pid);
     bufferPool.markDirty(pid);
     size_t child1 = pid.page;
-    new_child1 = root_page;
+    std::copy(root_page.begin(), root_page.end(), new_child1.begin());
     IndexPage child1_page(new_child1);
 
     pid.page = numPages++;
-    Page &new_child2 = bufferPool.getPage(pid);
+    std::span<uint8_t> new_child2 = bufferPool.getPageBytes(pid);
     bufferPool.markDirty(pid);
     size_t child2 = pid.page;
     IndexPage child2_page(new_child2);
@@ -102,33 +114,60 @@ void BTreeFile::deleteTuple(const Iterator &it) {
 
 Tuple BTreeFile::getTuple(const Iterator &it) const {
     // TODO pa2
-    BufferPool &bufferPool = getDatabase().getBufferPool();
-    PageId pid{name, it.page};
-    Page &page = bufferPool.getPage(pid);
-    LeafPage leaf(page, td, key_index);
+    PageGuard guard = pinForRead(it.page);
+    LeafPage leaf(guard.page(), td, key_index);
     return leaf.getTuple(it.slot);
 }
 
 void BTreeFile::next(Iterator &it) const {
     // TODO pa2
     BufferPool &bufferPool = getDatabase().getBufferPool();
-    PageId pid{name, it.page};
-    Page &page = bufferPool.getPage(pid);
-    LeafPage leaf(page, td, key_index);
+    PageGuard guard = pinForRead(it.page);
+    LeafPage leaf(guard.page(), td, key_index);
     if (it.slot + 1 < leaf.header->size) {
         it.slot++;
     } else {
         it.page = leaf.header->next_leaf;
         it.slot = 0;
+        if (it.page != root_id && !isMapped() && bufferPool.getPrefetchDepth() > 0) {
+            prefetchLeaves(it.page);
+        }
+    }
+}
+
+// Keeps the prefetcher getPrefetchDepth() leaves ahead of a scan that moved to a leaf. Leaves are not consecutive
+// pages, so they are found in the leaf order of the index pages. Once the leaves that follow are requested, each step
+// only requests the leaf that enters the window, and the ones requested before are not pinned again.
+void BTreeFile::prefetchLeaves(size_t leaf) const {
+    BufferPool &bufferPool = getDatabase().getBufferPool();
+    PageId start{id, 0};
+    size_t count;
+    {
+        std::lock_guard lock(leaf_mutex);
+        if (leaf_pages != numPages) {
+            // Splits add pages, so the order only changes with the number of pages.
+            leaf_order = leaves();
+            leaf_rank.assign(numPages, SIZE_MAX);
+            for (size_t i = 0; i < leaf_order.size(); ++i) leaf_rank[leaf_order[i]] = i;
+            leaf_pages = numPages;
+        }
+        if (leaf >= leaf_rank.size() || leaf_rank[leaf] == SIZE_MAX) return;
+        size_t rank = leaf_rank[leaf];
+        size_t last = std::min(rank + bufferPool.getPrefetchDepth(), leaf_order.size() - 1);
+        if (last == rank || bufferPool.contains({id, leaf_order[last]})) return;
+        size_t first = bufferPool.contains({id, leaf_order[rank + 1]}) ? last : rank + 1;
+        start.page = leaf_order[first];
+        count = last - first + 1;
     }
+    bufferPool.prefetch(start, count, nextLeaf);
 }
 
 Iterator BTreeFile::begin() const {
     // TODO pa2
     BufferPool &bufferPool = getDatabase().getBufferPool();
-    PageId pid{name, root_id};
+    PageId pid{id, root_id};
     while (true) {
-        Page &page = bufferPool.getPage(pid);
+        std::span<uint8_t> page = bufferPool.getPageBytes(pid);
         IndexPage node(page);
         pid.page = node.children[0];
         if (!node.header->index_children) {
@@ -138,6 +177,63 @@ Iterator BTreeFile::begin() const {
     return {*this, pid.page, 0};
 }
 
+std::vector<size_t> BTreeFile::leaves() const {
+    BufferPool &bufferPool = getDatabase().getBufferPool();
+    std::vector<size_t> level{root_id};
+    while (true) {
+        std::vector<size_t> children;
+        bool leafChildren = false;
+        for (size_t page: level) {
+            IndexPage node(bufferPool.getPageBytes({id, page}));
+            children.insert(children.end(), node.children, node.children + node.header->size + 1);
+            leafChildren = !node.header->index_children;
+        }
+        if (leafChildren) {
+            // An empty tree has no leaves: the root points back to page 0.
+            if (children.size() == 1 && children[0] == root_id) children.clear();
+            return children;
+        }
+        level = std::move(children);
+    }
+}
+
+Iterator BTreeFile::seek(int key) const {
+    BufferPool &bufferPool = getDatabase().getBufferPool();
+    PageId pid{id, root_id};
+    while (true) {
+        std::span<uint8_t> page = bufferPool.getPageBytes(pid);
+        IndexPage node(page);
+        auto pos = std::lower_bound(node.keys, node.keys + node.header->size, key);
+        pid.page = node.children[pos - node.keys];
+        if (!node.header->index_children) {
+            break;
+        }
+    }
+    // An empty tree has no leaves: the root points back to page 0.
+    while (pid.page != root_id) {
+        std::span<uint8_t> page = bufferPool.getPageBytes(pid);
+        LeafPage leaf(page, td, key_index);
+        const uint8_t *first = leaf.data + td.offset_of(key_index);
+        size_t lo = 0;
+        size_t hi = leaf.header->size;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            int k;
+            std::memcpy(&k, first + mid * td.length(), sizeof(k));
+            if (k < key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < leaf.header->size) {
+            return {*this, pid.page, lo};
+        }
+        pid.page = leaf.header->next_leaf;
+    }
+    return end();
+}
+
 Iterator BTreeFile::end() const {
     // TODO pa2
     return {*this, 0, 0};
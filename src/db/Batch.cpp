@@ -0,0 +1,111 @@
+#include <db/Batch.hpp>
+#include <cstring>
+#include <stdexcept>
+
+using namespace db;
+
+Batch::Batch(const TupleDesc &td) {
+    columns.reserve(td.size());
+    for (size_t i = 0; i < td.size(); i++) {
+        switch (td.type_of(i)) {
+            case type_t::INT:
+                columns.emplace_back(std::vector<int>());
+                break;
+            case type_t::DOUBLE:
+                columns.emplace_back(std::vector<double>());
+                break;
+            case type_t::CHAR:
+                columns.emplace_back(std::vector<std::string>());
+                break;
+        }
+    }
+}
+
+size_t Batch::size() const { return rows; }
+
+size_t Batch::width() const { return columns.size(); }
+
+void Batch::clear() {
+    for (auto &col: columns) {
+        std::visit([](auto &values) { values.clear(); }, col);
+    }
+    rows = 0;
+}
+
+void Batch::append(const Tuple &t) {
+    if (t.size() != columns.size()) {
+        throw std::logic_error("Tuple not compatible with Batch");
+    }
+    for (size_t i = 0; i < columns.size(); i++) {
+        std::visit([&](auto &values) {
+            using T = typename std::decay_t<decltype(values)>::value_type;
+            values.push_back(std::get<T>(t.get_field(i)));
+        }, columns[i]);
+    }
+    rows++;
+}
+
+void Batch::append(const uint8_t *data, const TupleDesc &td) {
+    for (size_t i = 0; i < columns.size(); i++) {
+        const uint8_t *field = data + td.offset_of(i);
+        std::visit([&](auto &values) {
+            using T = typename std::decay_t<decltype(values)>::value_type;
+            if constexpr (std::is_same_v<T, std::string>) {
+                const char *chars = reinterpret_cast<const char *>(field);
+                values.emplace_back(chars, strnlen(chars, CHAR_SIZE));
+            } else {
+                T v;
+                std::memcpy(&v, field, sizeof(T));
+                values.push_back(v);
+            }
+        }, columns[i]);
+    }
+    rows++;
+}
+
+const column_t &Batch::column(size_t i) const { return columns.at(i); }
+
+column_t &Batch::column(size_t i) { return columns.at(i); }
+
+field_t Batch::get_field(size_t row, size_t i) const {
+    return std::visit([row](const auto &values) { return field_t(values[row]); }, columns.at(i));
+}
+
+Tuple Batch::get_tuple(size_t row) const {
+    std::vector<field_t> fields;
+    fields.reserve(columns.size());
+    for (size_t i = 0; i < columns.size(); i++) {
+        fields.push_back(get_field(row, i));
+    }
+    return {fields};
+}
+
+void Batch::select(const std::vector<uint8_t> &selection) {
+    size_t kept = 0;
+    for (auto &col: columns) {
+        std::visit([&](auto &values) {
+            kept = 0;
+            for (size_t row = 0; row < rows; row++) {
+                if (selection[row]) {
+                    if (kept != row) values[kept] = std::move(values[row]);
+                    kept++;
+                }
+            }
+            values.resize(kept);
+        }, col);
+    }
+    if (columns.empty()) {
+        kept = 0;
+        for (size_t row = 0; row < rows; row++) kept += selection[row] != 0;
+    }
+    rows = kept;
+}
+
+void Batch::project(const std::vector<size_t> &indices) {
+    std::vector<column_t> projected;
+    projected.reserve(indices.size());
+    for (size_t i: indices) {
+        projected.push_back(columns.at(i));
+    }
+    columns = std::move(projected);
+}
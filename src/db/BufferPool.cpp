@@ -1,123 +1,864 @@
 #include <db/BufferPool.hpp>
 #include <db/Database.hpp>
-#include <numeric>
+#include <algorithm>
+#include <exception>
+#include <sys/mman.h>
 
 using namespace db;
 
-BufferPool::BufferPool() {
-    // Initialize free slots with indices 0 to DEFAULT_NUM_PAGES-1.
-    for (size_t i = 0; i < DEFAULT_NUM_PAGES; ++i) {
+PageGuard::PageGuard(BufferPool *pool, size_t frame, Latch latch) : pool(pool), frame(frame), latch(latch) {}
+
+// The mapping is read-only: the page is only modified by mistake, which faults.
+PageGuard::PageGuard(std::span<const uint8_t> mapped)
+        : pool(nullptr), frame(0), latch(Latch::SHARED), mapped(const_cast<uint8_t *>(mapped.data()), mapped.size()) {}
+
+PageGuard::PageGuard(PageGuard &&other) noexcept
+        : pool(other.pool), frame(other.frame), latch(other.latch), mapped(other.mapped) {
+    other.pool = nullptr;
+    other.mapped = {};
+}
+
+PageGuard &PageGuard::operator=(PageGuard &&other) noexcept {
+    if (this != &other) {
+        release();
+        pool = other.pool;
+        frame = other.frame;
+        latch = other.latch;
+        mapped = other.mapped;
+        other.pool = nullptr;
+        other.mapped = {};
+    }
+    return *this;
+}
+
+PageGuard::~PageGuard() { release(); }
+
+std::span<uint8_t> PageGuard::page() const { return pool ? pool->data(frame) : mapped; }
+
+void PageGuard::markDirty() const {
+    if (!pool) {
+        throw std::logic_error("Cannot modify a page of a mapped file");
+    }
+    pool->setDirty(frame);
+}
+
+void PageGuard::release() {
+    mapped = {};
+    if (pool == nullptr) {
+        return;
+    }
+    if (latch == Latch::EXCLUSIVE) {
+        pool->frames_[frame].latch.unlock();
+    } else {
+        pool->frames_[frame].latch.unlock_shared();
+    }
+    pool->unpin(frame);
+    pool = nullptr;
+}
+
+BufferPool::BufferPool(const BufferPoolOptions &options)
+        : num_pages_(options.pages), frame_size_(options.page_size), huge_pages_(options.huge_pages),
+          frames_(std::make_unique<Frame[]>(options.pages)),
+          policy_(make_policy(options.replacement, options.pages)), prefetch_depth_(options.prefetch_depth) {
+    if (num_pages_ == 0) {
+        throw std::invalid_argument("A buffer pool needs at least one page");
+    }
+    if (!valid_page_size(frame_size_)) {
+        throw std::invalid_argument("The page size is not a power of two between 4 and 64 KB");
+    }
+    if (options.dirty_threshold < 0 || options.dirty_threshold > 1) {
+        throw std::invalid_argument("The dirty threshold is a proportion of the pages");
+    }
+    size_t bytes = num_pages_ * frame_size_;
+    memory_ = MAP_FAILED;
+    if (options.huge_pages) {
+        mapped_ = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+#ifdef MAP_HUGETLB
+        memory_ = mmap(nullptr, mapped_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (memory_ == MAP_FAILED) {
+            // Not enough reserved huge pages: over-allocate to align the pages, and ask for transparent huge pages.
+            size_t size = mapped_ + HUGE_PAGE_SIZE;
+            void *raw = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED) {
+                throw std::runtime_error("mmap");
+            }
+            auto start = reinterpret_cast<uintptr_t>(raw);
+            auto aligned = (start + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+            if (aligned > start) {
+                munmap(raw, aligned - start);
+            }
+            if (aligned + mapped_ < start + size) {
+                munmap(reinterpret_cast<void *>(aligned + mapped_), start + size - aligned - mapped_);
+            }
+            memory_ = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+            madvise(memory_, mapped_, MADV_HUGEPAGE);
+#endif
+        }
+    } else {
+        mapped_ = bytes;
+        // Only the pages written to are backed by memory, so the frames are reserved without accounting for them.
+        memory_ = mmap(nullptr, mapped_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (memory_ == MAP_FAILED) {
+            throw std::runtime_error("mmap");
+        }
+    }
+    // The mapping starts at a page boundary and frames are a multiple of DEFAULT_PAGE_SIZE, so every frame can be the
+    // buffer of direct I/O.
+    static_assert(DEFAULT_PAGE_SIZE % DIRECT_IO_ALIGNMENT == 0);
+    pages_ = static_cast<uint8_t *>(memory_);
+
+    // Initialize free slots with indices 0 to num_pages_-1.
+    for (size_t i = 0; i < num_pages_; ++i) {
         free_slots_.push_back(i);
     }
+    if (prefetch_depth_ > 0) {
+        prefetcher_ = std::thread(&BufferPool::prefetchLoop, this);
+    }
+    dirty_limit_ = options.dirty_threshold == 0
+                   ? 0 : std::max<size_t>(1, static_cast<size_t>(options.dirty_threshold * num_pages_));
+    flush_start_ = std::chrono::steady_clock::now().time_since_epoch().count();
+    if (dirty_limit_ > 0) {
+        flusher_ = std::thread(&BufferPool::flushLoop, this);
+    }
 }
 
 BufferPool::~BufferPool() {
+    if (prefetcher_.joinable()) {
+        {
+            std::lock_guard lock(prefetch_mutex_);
+            stopping_ = true;
+        }
+        prefetch_cv_.notify_one();
+        prefetcher_.join();
+    }
+    if (flusher_.joinable()) {
+        {
+            std::lock_guard lock(flush_mutex_);
+            flush_stopping_ = true;
+        }
+        flush_cv_.notify_one();
+        flusher_.join();
+    }
     // Flush all dirty pages when the BufferPool is destroyed.
-    std::vector<PageId> toFlush(dirty_pages_.begin(), dirty_pages_.end());
-    for (const auto &pid : toFlush) {
-        flushPage(pid);
+    try {
+        flushAll([](const PageId &) { return true; });
+    } catch (...) {
+        // The pages that could not be written are lost.
     }
+    munmap(memory_, mapped_);
 }
 
-Page &BufferPool::getPage(const PageId &pid) {
-    if (contains(pid)) {
-        // If already present, update LRU (move to front).
-        lru_list_.erase(lru_map_[pid]);
-        lru_list_.push_front(pid);
-        lru_map_[pid] = lru_list_.begin();
-        return pages_[page_table_.at(pid)];
+size_t BufferPool::getNumPages() const { return num_pages_; }
+
+size_t BufferPool::getPageSize() const { return frame_size_; }
+
+std::span<uint8_t> BufferPool::data(size_t slot) const { return {pages_ + slot * frame_size_, frames_[slot].size}; }
+
+BufferPool::Stripe &BufferPool::stripe(const PageId &pid) const {
+    // The tables index their entries with the low bits of the hash, so pick the stripe with the high bits.
+    return stripes_[(std::hash<const PageId>()(pid) >> 48) % PAGE_TABLE_STRIPES];
+}
+
+template<typename F>
+void BufferPool::forEach(const F &f) const {
+    for (auto &s : stripes_) {
+        std::lock_guard lock(s.mutex);
+        s.table.forEach([&](const PageId &pid, size_t) { f(pid); });
+    }
+}
+
+void BufferPool::unpin(size_t slot) { --frames_[slot].pins; }
+
+void BufferPool::setDirty(size_t slot) {
+    if (!frames_[slot].dirty.exchange(true) && ++dirty_pages_ == dirty_limit_) {
+        flush_cv_.notify_one();
+    }
+}
+
+bool BufferPool::takeDirty(size_t slot) {
+    if (!frames_[slot].dirty.exchange(false)) {
+        return false;
+    }
+    --dirty_pages_;
+    return true;
+}
+
+// Returns a slot that no other thread can take: either a free slot, or an unpinned slot taken from the replacement
+// policy. The slot is unmapped and pinned once for the caller.
+size_t BufferPool::victim() {
+    while (true) {
+        {
+            std::lock_guard lock(free_mutex_);
+            if (!free_slots_.empty()) {
+                size_t slot = free_slots_.front();
+                free_slots_.pop_front();
+                frames_[slot].pins = 1;
+                return slot;
+            }
+        }
+        std::optional<size_t> evicted = policy_->evict([&](size_t s) { return frames_[s].pins == 0; });
+        if (!evicted) {
+            throw std::runtime_error("Every page in the buffer pool is pinned");
+        }
+        size_t slot = *evicted;
+
+        // Write the page back while it is still mapped, so a thread asking for it meanwhile does not read a stale copy.
+        Frame &frame = frames_[slot];
+        const PageId pid = frame.pid;
+        {
+            std::shared_lock latch(frame.latch);
+            if (takeDirty(slot)) {
+                try {
+                    getDatabase().get(pid.file).writePage(data(slot), pid.page);
+                } catch (...) {
+                    setDirty(slot);
+                    policy_->restore(slot);
+                    throw;
+                }
+            }
+        }
+
+        {
+            Stripe &s = stripe(pid);
+            std::lock_guard lock(s.mutex);
+            std::optional<size_t> mapped = s.table.find(pid);
+            if (mapped != slot) {
+                // Discarded while it was being written back.
+                frame.pins = 1;
+                return slot;
+            }
+            if (frame.pins == 0 && !frame.dirty) {
+                s.table.erase(pid);
+                frame.pins = 1;
+                return slot;
+            }
+        }
+        // Pinned or modified while it was being written back: keep it and look for another one.
+        policy_->restore(slot);
+    }
+}
+
+// Returns the slot of the page, pinned once for the caller. The page may still be loading: latch the slot to wait.
+// Requests of the prefetcher neither count as hits or misses nor make the page more recently used.
+size_t BufferPool::fetch(const PageId &pid, bool prefetch) {
+    Stripe &s = stripe(pid);
+    std::optional<size_t> found;
+    {
+        std::lock_guard lock(s.mutex);
+        found = s.table.find(pid);
+        if (found) {
+            ++frames_[*found].pins;
+        }
+    }
+    if (found) {
+        if (!prefetch) {
+            ++frames_[*found].counters->hits;
+            policy_->access(*found);
+            sequential(*frames_[*found].counters, pid);
+        }
+        return *found;
     }
 
     // Page is not in the buffer pool.
-    size_t slot;
-    if (!free_slots_.empty()) {
-        slot = free_slots_.front();
-        free_slots_.pop_front();
-    } else {
-        // Buffer full: evict the least-recently used page (back of the LRU list).
-        PageId evictPid = lru_list_.back();
-        lru_list_.pop_back();
-        lru_map_.erase(evictPid);
-        slot = page_table_.at(evictPid);
-        if (isDirty(evictPid)) {
-            flushPage(evictPid);
+    auto [slot, load] = claim(pid, prefetch);
+    if (!load) {
+        return slot;
+    }
+    try {
+        Database &db = getDatabase();
+        DbFile &file = db.get(pid.file);
+        file.readPage(data(slot), pid.page);
+    } catch (...) {
+        abandon(slot);
+        throw;
+    }
+    loaded(slot);
+    if (!prefetch) {
+        sequential(*frames_[slot].counters, pid);
+    }
+    return slot;
+}
+
+// Maps a page that was not in the pool to a slot, pinned once for the caller. Returns the slot and true if the caller
+// must load the page: the slot is then latched exclusively until loaded() or abandon(). Returns the slot of the page
+// and false if another thread mapped the page in the meantime.
+std::pair<size_t, bool> BufferPool::claim(const PageId &pid, bool prefetch) {
+    size_t size = getDatabase().get(pid.file).getPageSize();
+    if (size > frame_size_) {
+        throw std::logic_error("The pages of the file are larger than the frames of the buffer pool");
+    }
+    Stripe &s = stripe(pid);
+    size_t slot = victim();
+    Frame &frame = frames_[slot];
+    if (frame.size > size && !huge_pages_) {
+        // Give back the memory of the larger page the frame held, past the end of this one.
+        madvise(pages_ + slot * frame_size_ + size, frame.size - size, MADV_DONTNEED);
+    }
+    std::unique_lock lock(s.mutex);
+    std::optional<size_t> found = s.table.find(pid);
+    if (found) {
+        // Another thread loaded the page in the meantime.
+        ++frames_[*found].pins;
+        lock.unlock();
+        {
+            std::lock_guard free(free_mutex_);
+            frame.pins = 0;
+            free_slots_.push_front(slot);
+        }
+        if (!prefetch) {
+            ++frames_[*found].counters->hits;
+            policy_->access(*found);
+        }
+        return {*found, false};
+    }
+    frame.pid = pid;
+    frame.size = size;
+    frame.dirty = false;
+    {
+        std::lock_guard stats(stats_mutex_);
+        frame.counters = &counters_[pid.file];
+    }
+    ++(prefetch ? frame.counters->prefetched : frame.counters->misses);
+    s.table.insert(pid, slot);
+    // Nobody else can hold the latch of a slot that is neither mapped nor pinned, so this does not wait while the
+    // stripe is locked (try_lock may fail spuriously).
+    while (!frame.latch.try_lock()) {
+    }
+    return {slot, true};
+}
+
+// Publishes a page read into a claimed slot.
+void BufferPool::loaded(size_t slot) {
+    frames_[slot].latch.unlock();
+    policy_->insert(slot, frames_[slot].pid);
+}
+
+// Unmaps a claimed slot whose page could not be read and returns it to the free slots.
+void BufferPool::abandon(size_t slot) {
+    Frame &frame = frames_[slot];
+    {
+        Stripe &s = stripe(frame.pid);
+        std::lock_guard lock(s.mutex);
+        s.table.erase(frame.pid);
+    }
+    frame.latch.unlock();
+    std::lock_guard free(free_mutex_);
+    frame.pins = 0;
+    free_slots_.push_front(slot);
+}
+
+// Detects requests for consecutive pages of a file, and then keeps the prefetcher prefetch_depth_ pages ahead of them.
+// The state is updated without synchronization: concurrent scans of a file only make the detection less accurate.
+void BufferPool::sequential(Counters &counters, const PageId &pid) {
+    if (prefetch_depth_ == 0) {
+        return;
+    }
+    uint32_t expected = counters.expected.load(std::memory_order_relaxed);
+    if (pid.page + 1 == expected) {
+        return; // The same page again.
+    }
+    counters.expected.store(pid.page + 1, std::memory_order_relaxed);
+    if (pid.page != expected) {
+        counters.ahead.store(pid.page, std::memory_order_relaxed);
+        return;
+    }
+    size_t first = std::max(counters.ahead.load(std::memory_order_relaxed), pid.page) + 1;
+    size_t last = pid.page + prefetch_depth_;
+    if (first > last) {
+        return;
+    }
+    counters.ahead.store(last, std::memory_order_relaxed);
+    prefetch({pid.file, first}, last - first + 1);
+}
+
+void BufferPool::prefetch(const PageId &pid, size_t count,
+                          std::function<std::optional<size_t>(std::span<const uint8_t>)> next) {
+    if (prefetch_depth_ == 0 || count == 0) {
+        return;
+    }
+    {
+        std::lock_guard lock(prefetch_mutex_);
+        prefetches_.push_back({pid, count, std::move(next)});
+    }
+    prefetch_cv_.notify_one();
+}
+
+void BufferPool::prefetchLoop() {
+    std::unique_lock lock(prefetch_mutex_);
+    while (true) {
+        prefetch_cv_.wait(lock, [&] { return stopping_ || !prefetches_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        Prefetch request = std::move(prefetches_.front());
+        prefetches_.pop_front();
+        prefetching_ = request.pid.file;
+        lock.unlock();
+
+        PageId pid = request.pid;
+        Counters *counters;
+        {
+            std::lock_guard stats(stats_mutex_);
+            counters = &counters_[pid.file];
+        }
+        try {
+            if (request.next) {
+                follow(request);
+            } else {
+                readAhead(request, *counters);
+            }
+        } catch (...) {
+            // Prefetching is only a hint: a removed file or a pool full of pinned pages ends the request.
+        }
+
+        lock.lock();
+        prefetching_.reset();
+        idle_cv_.notify_all();
+    }
+}
+
+// Reads the consecutive pages of a request that are not in the pool yet, in a single batch.
+void BufferPool::readAhead(const Prefetch &request, const Counters &counters) {
+    DbFile &file = getDatabase().get(request.pid.file);
+    std::vector<size_t> slots;
+    std::vector<IoRequest> reads;
+    PageId pid = request.pid;
+    try {
+        for (size_t i = 0; i < request.count && pid.page < file.getNumPages(); ++i, ++pid.page) {
+            // Skip the pages a scan already went past while the request was queued.
+            if (pid.page + 1 < counters.expected.load(std::memory_order_relaxed) || contains(pid)) {
+                continue;
+            }
+            auto [slot, load] = claim(pid, true);
+            if (!load) {
+                unpin(slot);
+                continue;
+            }
+            try {
+                reads.push_back(file.readRequest(data(slot), pid.page));
+            } catch (...) {
+                abandon(slot);
+                throw;
+            }
+            slots.push_back(slot);
         }
-        page_table_.erase(evictPid);
-        dirty_pages_.erase(evictPid);
+    } catch (...) {
+        // The pool is full of pinned pages, or a page cannot be read in a batch: read the pages claimed so far.
+    }
+
+    bool submitted = false;
+    try {
+        io_.run(reads);
+        submitted = true;
+    } catch (...) {
+    }
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (submitted && reads[i].result >= 0) {
+            loaded(slots[i]);
+            unpin(slots[i]);
+        } else {
+            abandon(slots[i]);
+        }
+    }
+}
+
+// Walks a chain of pages, one page at a time since the next page is only known once a page is read.
+void BufferPool::follow(const Prefetch &request) {
+    PageId pid = request.pid;
+    for (size_t i = 0; i < request.count; ++i) {
+        size_t slot = fetch(pid, true);
+        std::optional<size_t> following;
+        {
+            // Wait for the page to be loaded.
+            std::shared_lock latch(frames_[slot].latch);
+            following = request.next(data(slot));
+        }
+        unpin(slot);
+        if (!following) {
+            break;
+        }
+        pid.page = *following;
+    }
+}
+
+void BufferPool::drainPrefetches() {
+    std::unique_lock lock(prefetch_mutex_);
+    idle_cv_.wait(lock, [&] { return prefetches_.empty() && !prefetching_; });
+}
+
+// Drops the queued requests for a file and waits for the one being processed, so its pages are not pinned.
+void BufferPool::cancelPrefetches(uint32_t file) {
+    std::unique_lock lock(prefetch_mutex_);
+    std::erase_if(prefetches_, [&](const Prefetch &request) { return request.pid.file == file; });
+    idle_cv_.wait(lock, [&] { return prefetching_ != file; });
+}
+
+size_t BufferPool::getPrefetchDepth() const { return prefetch_depth_; }
+
+Page &BufferPool::getPage(const PageId &pid) {
+    size_t slot = fetch(pid);
+    {
+        // Wait for the page to be loaded.
+        std::shared_lock latch(frames_[slot].latch);
     }
+    unpin(slot);
+    return *reinterpret_cast<Page *>(pages_ + slot * frame_size_);
+}
 
-    // Load the page from disk.
-    Database &db = getDatabase();
-    DbFile &file = db.get(pid.file);
-    file.readPage(pages_[slot], pid.page);
+std::span<uint8_t> BufferPool::getPageBytes(const PageId &pid) {
+    size_t slot = fetch(pid);
+    {
+        // Wait for the page to be loaded.
+        std::shared_lock latch(frames_[slot].latch);
+    }
+    unpin(slot);
+    return data(slot);
+}
 
-    // Insert the new page into our tracking structures.
-    page_table_[pid] = slot;
-    lru_list_.push_front(pid);
-    lru_map_[pid] = lru_list_.begin();
-    return pages_[slot];
+PageGuard BufferPool::pin(const PageId &pid, Latch latch) {
+    size_t slot = fetch(pid);
+    if (latch == Latch::EXCLUSIVE) {
+        frames_[slot].latch.lock();
+    } else {
+        frames_[slot].latch.lock_shared();
+    }
+    return {this, slot, latch};
 }
 
 void BufferPool::markDirty(const PageId &pid) {
-    if (!contains(pid)) {
+    Stripe &s = stripe(pid);
+    std::lock_guard lock(s.mutex);
+    std::optional<size_t> slot = s.table.find(pid);
+    if (!slot) {
         throw std::logic_error("Page not in buffer pool");
     }
-    dirty_pages_.insert(pid);
+    setDirty(*slot);
 }
 
 bool BufferPool::isDirty(const PageId &pid) const {
-    if (page_table_.find(pid) == page_table_.end()) {
+    Stripe &s = stripe(pid);
+    std::lock_guard lock(s.mutex);
+    std::optional<size_t> slot = s.table.find(pid);
+    if (!slot) {
         throw std::runtime_error("PageId is not in the buffer pool");
     }
-    return dirty_pages_.find(pid) != dirty_pages_.end();
+    return frames_[*slot].dirty;
 }
 
 bool BufferPool::contains(const PageId &pid) const {
-    return page_table_.find(pid) != page_table_.end();
+    Stripe &s = stripe(pid);
+    std::lock_guard lock(s.mutex);
+    return s.table.find(pid).has_value();
 }
 
 void BufferPool::discardPage(const PageId &pid) {
-    auto it = page_table_.find(pid);
-    if (it == page_table_.end()) {
+    Stripe &s = stripe(pid);
+    std::lock_guard lock(s.mutex);
+    std::optional<size_t> found = s.table.find(pid);
+    if (!found) {
         return; // Nothing to do.
     }
-    size_t slot = it->second;
-    page_table_.erase(it);
-    auto lruIt = lru_map_.find(pid);
-    if (lruIt != lru_map_.end()) {
-        lru_list_.erase(lruIt->second);
-        lru_map_.erase(lruIt);
+    size_t slot = *found;
+    if (frames_[slot].pins != 0) {
+        throw std::logic_error("Cannot discard a pinned page");
     }
-    dirty_pages_.erase(pid);
+    s.table.erase(pid);
+    takeDirty(slot);
+    if (!policy_->remove(slot)) {
+        return; // Being evicted: the evicting thread keeps the slot.
+    }
+    std::lock_guard free(free_mutex_);
     free_slots_.push_back(slot);
 }
 
 void BufferPool::flushPage(const PageId &pid) {
-    if (!contains(pid)) {
-        return;
+    size_t slot;
+    {
+        Stripe &s = stripe(pid);
+        std::lock_guard lock(s.mutex);
+        std::optional<size_t> found = s.table.find(pid);
+        if (!found) {
+            return;
+        }
+        slot = *found;
+        ++frames_[slot].pins;
     }
 
-    if (!isDirty(pid)) {
-        return;
+    Frame &frame = frames_[slot];
+    std::shared_lock latch(frame.latch);
+    if (takeDirty(slot)) {
+        try {
+            Database &db = getDatabase();
+            DbFile &file = db.get(pid.file);
+            file.writePage(data(slot), pid.page);
+        } catch (...) {
+            setDirty(slot);
+            unpin(slot);
+            throw;
+        }
     }
-
-    size_t slot = page_table_.at(pid);
-    Database &db = getDatabase();
-    DbFile &file = db.get(pid.file);
-    file.writePage(pages_[slot], pid.page);
-    dirty_pages_.erase(pid);
+    unpin(slot);
 }
 
 void BufferPool::flushFile(const std::string &file) {
-    // Note: Corrected the variable name from an undefined 'fileName' to 'file'.
-    std::vector<PageId> pagesToFlush;
-    for (const auto &entry : page_table_) {
-        const PageId &pid = entry.first;
-        if (pid.file == file && isDirty(pid)) {
-            pagesToFlush.push_back(pid);
+    uint32_t id = getDatabase().getId(file);
+    flushAll([&](const PageId &pid) { return pid.file == id; });
+}
+
+// Writes the dirty pages selected by a predicate back in a single batch. Pages latched exclusively by another thread
+// are left out of the batch and flushed one by one afterwards, so this never waits for a latch while holding others.
+template<typename F>
+void BufferPool::flushAll(const F &select) {
+    std::vector<size_t> pinned;
+    for (auto &s: stripes_) {
+        std::lock_guard lock(s.mutex);
+        s.table.forEach([&](const PageId &pid, size_t slot) {
+            if (select(pid)) {
+                ++frames_[slot].pins;
+                pinned.push_back(slot);
+            }
+        });
+    }
+
+    std::vector<size_t> slots;
+    std::vector<IoRequest> writes;
+    std::vector<PageId> busy;
+    std::exception_ptr error;
+    size_t next = 0;
+    try {
+        for (; next < pinned.size(); ++next) {
+            size_t slot = pinned[next];
+            Frame &frame = frames_[slot];
+            if (!frame.dirty) {
+                unpin(slot);
+                continue;
+            }
+            DbFile &file = getDatabase().get(frame.pid.file);
+            if (!frame.latch.try_lock_shared()) {
+                busy.push_back(frame.pid);
+                unpin(slot);
+            } else if (!takeDirty(slot)) {
+                frame.latch.unlock_shared();
+                unpin(slot);
+            } else {
+                writes.push_back(file.writeRequest(data(slot), frame.pid.page));
+                slots.push_back(slot);
+            }
         }
+        io_.run(writes);
+    } catch (...) {
+        error = std::current_exception();
+        for (; next < pinned.size(); ++next) {
+            unpin(pinned[next]);
+        }
+    }
+
+    bool failed = false;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        Frame &frame = frames_[slots[i]];
+        if (error || writes[i].result != static_cast<ssize_t>(frame.size)) {
+            setDirty(slots[i]);
+            failed = true;
+        }
+        frame.latch.unlock_shared();
+        unpin(slots[i]);
+    }
+    if (error) {
+        std::rethrow_exception(error);
     }
-    for (const auto &pid : pagesToFlush) {
+    for (const auto &pid: busy) {
         flushPage(pid);
     }
+    if (failed) {
+        throw std::runtime_error("pwrite");
+    }
+}
+
+void BufferPool::flushLoop() {
+    std::unique_lock lock(flush_mutex_);
+    while (true) {
+        flush_cv_.wait_for(lock, FLUSH_INTERVAL);
+        if (flush_stopping_) {
+            return;
+        }
+        if (dirty_pages_ < dirty_limit_) {
+            continue;
+        }
+        lock.unlock();
+        try {
+            writeBack();
+        } catch (...) {
+            // The pages that could not be written stay dirty and are tried again.
+        }
+        lock.lock();
+    }
+}
+
+// Writes the dirty pages back, a run of consecutive pages of a file at a time. Pages latched exclusively are being
+// modified: they are skipped, and split the run they are in. The pages of a file are unpinned as soon as its runs are
+// written, and the files being discarded are left out.
+void BufferPool::writeBack() {
+    std::vector<std::pair<PageId, size_t>> dirty;
+    {
+        std::lock_guard writing(flush_mutex_);
+        for (auto &s: stripes_) {
+            std::lock_guard lock(s.mutex);
+            s.table.forEach([&](const PageId &pid, size_t slot) {
+                if (frames_[slot].dirty && !discarding_.contains(pid.file)) {
+                    ++frames_[slot].pins;
+                    dirty.emplace_back(pid, slot);
+                    writing_.insert(pid.file);
+                }
+            });
+        }
+    }
+    std::sort(dirty.begin(), dirty.end(), [](const auto &a, const auto &b) {
+        return a.first.file != b.first.file ? a.first.file < b.first.file : a.first.page < b.first.page;
+    });
+
+    std::vector<size_t> run;
+    std::vector<const uint8_t *> pages;
+    std::exception_ptr error;
+    auto write = [&] {
+        if (run.empty()) {
+            return;
+        }
+        const PageId &first = frames_[run.front()].pid;
+        try {
+            if (!error) {
+                getDatabase().get(first.file).writePages(pages, first.page);
+                flushed_pages_ += run.size();
+                ++flush_writes_;
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (size_t slot: run) {
+            if (error) {
+                setDirty(slot);
+            }
+            frames_[slot].latch.unlock_shared();
+        }
+        run.clear();
+        pages.clear();
+    };
+    size_t unpinned = 0;
+    auto release = [&](size_t end) {
+        if (unpinned == end) {
+            return;
+        }
+        uint32_t file = dirty[unpinned].first.file;
+        for (; unpinned < end; ++unpinned) {
+            unpin(dirty[unpinned].second);
+        }
+        std::lock_guard lock(flush_mutex_);
+        writing_.erase(file);
+        written_cv_.notify_all();
+    };
+    for (size_t i = 0; i < dirty.size(); ++i) {
+        auto [pid, slot] = dirty[i];
+        Frame &frame = frames_[slot];
+        if (i > 0 && dirty[i - 1].first.file != pid.file) {
+            write();
+            release(i);
+        }
+        if (!run.empty() && (run.size() == FLUSH_RUN || !(dirty[i - 1].first.file == pid.file &&
+                                                           dirty[i - 1].first.page + 1 == pid.page))) {
+            write();
+        }
+        if (!frame.latch.try_lock_shared()) {
+            write();
+        } else if (!takeDirty(slot)) {
+            frame.latch.unlock_shared();
+            write();
+        } else {
+            run.push_back(slot);
+            pages.push_back(data(slot).data());
+        }
+    }
+    write();
+    release(dirty.size());
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void BufferPool::discardFile(const std::string &file) {
+    uint32_t id = getDatabase().getId(file);
+    cancelPrefetches(id);
+    {
+        // The writer pins the pages it writes back: wait until it unpinned those of the file.
+        std::unique_lock lock(flush_mutex_);
+        discarding_.insert(id);
+        written_cv_.wait(lock, [&] { return !writing_.contains(id); });
+    }
+    std::vector<PageId> pagesToDiscard;
+    forEach([&](const PageId &pid) {
+        if (pid.file == id) {
+            pagesToDiscard.push_back(pid);
+        }
+    });
+    try {
+        for (const auto &pid : pagesToDiscard) {
+            discardPage(pid);
+        }
+    } catch (...) {
+        std::lock_guard lock(flush_mutex_);
+        discarding_.erase(id);
+        throw;
+    }
+    {
+        std::lock_guard lock(flush_mutex_);
+        discarding_.erase(id);
+    }
+    policy_->forgetFile(id);
+    std::lock_guard lock(stats_mutex_);
+    counters_.erase(id);
+}
+
+PageStats BufferPool::getStats() const {
+    std::lock_guard lock(stats_mutex_);
+    PageStats stats;
+    for (const auto &[file, counters]: counters_) {
+        stats.hits += counters.hits;
+        stats.misses += counters.misses;
+        stats.prefetched += counters.prefetched;
+    }
+    return stats;
+}
+
+PageStats BufferPool::getStats(const std::string &file) const {
+    uint32_t id = getDatabase().getId(file);
+    std::lock_guard lock(stats_mutex_);
+    auto it = counters_.find(id);
+    if (it == counters_.end()) {
+        return {};
+    }
+    return {it->second.hits, it->second.misses, it->second.prefetched};
+}
+
+double BufferPool::getDirtyRatio() const { return static_cast<double>(dirty_pages_) / num_pages_; }
+
+FlushStats BufferPool::getFlushStats() const {
+    FlushStats stats;
+    stats.pages = flushed_pages_;
+    stats.writes = flush_writes_;
+    std::chrono::steady_clock::duration elapsed{std::chrono::steady_clock::now().time_since_epoch().count() - flush_start_};
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    stats.rate = seconds > 0 ? stats.pages / seconds : 0;
+    return stats;
+}
+
+void BufferPool::resetStats() {
+    flushed_pages_ = 0;
+    flush_writes_ = 0;
+    flush_start_ = std::chrono::steady_clock::now().time_since_epoch().count();
+    std::lock_guard lock(stats_mutex_);
+    for (auto &[file, counters]: counters_) {
+        counters.hits = 0;
+        counters.misses = 0;
+        counters.prefetched = 0;
+    }
 }
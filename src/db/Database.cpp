@@ -2,7 +2,15 @@
 
 using namespace db;
 
-BufferPool &Database::getBufferPool() { return bufferPool; }
+Database::Database() : bufferPool(std::make_unique<BufferPool>()) {}
+
+BufferPool &Database::getBufferPool() { return *bufferPool; }
+
+void Database::setBufferPool(const BufferPoolOptions &options) {
+    // Release the memory of the current pool before mapping the new one.
+    bufferPool.reset();
+    bufferPool = std::make_unique<BufferPool>(options);
+}
 
 Database &db::getDatabase() {
     static Database instance;
@@ -14,6 +22,18 @@ void Database::add(std::unique_ptr<DbFile> file) {
     if (files_.count(name)) {
         throw std::logic_error("File already exists in the database");
     }
+    {
+        std::unique_lock lock(ids_mutex_);
+        if (free_ids_.empty()) {
+            file->id = static_cast<uint32_t>(by_id_.size());
+            by_id_.push_back(file.get());
+        } else {
+            file->id = free_ids_.back();
+            free_ids_.pop_back();
+            by_id_[file->id] = file.get();
+        }
+        ids_[name] = file->id;
+    }
     files_[name] = std::move(file);
 }
 
@@ -23,9 +43,18 @@ std::unique_ptr<DbFile> Database::remove(const std::string &name) {
         throw std::logic_error("File does not exist in the database");
     }
     // Flush any dirty pages for this file.
-    bufferPool.flushFile(name);
+    bufferPool->flushFile(name);
+    // The id goes to the next file added, so none of the pages of this one may stay in the pool under it.
+    bufferPool->discardFile(name);
     // Remove the file from the catalog and return it.
     std::unique_ptr<DbFile> removedFile = std::move(it->second);
+    {
+        std::unique_lock lock(ids_mutex_);
+        ids_.erase(name);
+        by_id_[removedFile->id] = nullptr;
+        free_ids_.push_back(removedFile->id);
+    }
+    removedFile->id = NO_FILE;
     files_.erase(it);
     return removedFile;
 }
@@ -36,4 +65,20 @@ DbFile &Database::get(const std::string &name) const {
         throw std::logic_error("File does not exist in the database");
     }
     return *(it->second);
-}
\ No newline at end of file
+}
+
+DbFile &Database::get(uint32_t id) const {
+    std::shared_lock lock(ids_mutex_);
+    if (id >= by_id_.size() || by_id_[id] == nullptr) {
+        throw std::logic_error("File does not exist in the database");
+    }
+    return *by_id_[id];
+}
+
+uint32_t Database::getId(const std::string &name) const {
+    std::shared_lock lock(ids_mutex_);
+    auto it = ids_.find(name);
+    return it == ids_.end() ? NO_FILE : it->second;
+}
+
+PageId::PageId(const std::string &file, size_t page) : PageId(getDatabase().getId(file), page) {}
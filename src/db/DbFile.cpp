@@ -1,15 +1,54 @@
+#include <db/Database.hpp>
 #include <db/DbFile.hpp>
 #include <stdexcept>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
 #include <cstring>
 
 using namespace db;
 
+namespace {
+    bool aligned(const void *data) { return reinterpret_cast<uintptr_t>(data) % DIRECT_IO_ALIGNMENT == 0; }
+
+    // The start of the header of a file whose pages are not DEFAULT_PAGE_SIZE bytes.
+    struct FileHeader {
+        char magic[8];
+        uint32_t page_size;
+    };
+
+    constexpr char MAGIC[8] = "DBPAGES";
+
+    // A buffer aligned for direct I/O, for pages that are not.
+    class Bounce {
+        uint8_t *buffer;
+
+    public:
+        explicit Bounce(size_t size)
+                : buffer(static_cast<uint8_t *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, size))) {
+            if (buffer == nullptr) {
+                throw std::bad_alloc();
+            }
+        }
+
+        ~Bounce() { std::free(buffer); }
+
+        uint8_t *data() const { return buffer; }
+    };
+} // namespace
+
 const TupleDesc &DbFile::getTupleDesc() const { return td; }
 
-DbFile::DbFile(const std::string &name, const TupleDesc &td) : name(name), td(td) {
+DbFile::DbFile(const std::string &name, const TupleDesc &td, size_t page_size)
+        : name(name), td(td), page_size(page_size) {
+    if (!valid_page_size(page_size)) {
+        throw std::invalid_argument("The page size is not a power of two between 4 and 64 KB");
+    }
     // TODO pa1: open file and initialize numPages
     // Hint: use open, fstat
     fd = open(name.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
@@ -18,9 +57,30 @@ DbFile::DbFile(const std::string &name, const TupleDesc &td) : name(name), td(td
     }
     struct stat st{};
     if (fstat(fd, &st) == -1) {
+        close(fd);
         throw std::runtime_error("fstat");
     }
-    numPages = st.st_size / DEFAULT_PAGE_SIZE;
+    // An existing file keeps its page size: files with a header record it, files without one have the default size.
+    FileHeader header{};
+    if (st.st_size >= static_cast<off_t>(FILE_HEADER_SIZE) && pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+        std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && valid_page_size(header.page_size)) {
+        this->page_size = header.page_size;
+        base = FILE_HEADER_SIZE;
+    } else if (st.st_size == 0 && page_size != DEFAULT_PAGE_SIZE) {
+        std::array<uint8_t, FILE_HEADER_SIZE> block{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.page_size = page_size;
+        std::memcpy(block.data(), &header, sizeof(header));
+        if (pwrite(fd, block.data(), block.size(), 0) != static_cast<ssize_t>(block.size())) {
+            close(fd);
+            throw std::runtime_error("pwrite");
+        }
+        base = FILE_HEADER_SIZE;
+        st.st_size = FILE_HEADER_SIZE;
+    } else {
+        this->page_size = DEFAULT_PAGE_SIZE;
+    }
+    numPages = (st.st_size - base) / this->page_size;
     if (numPages == 0) {
         numPages = 1;
     }
@@ -29,24 +89,183 @@ DbFile::DbFile(const std::string &name, const TupleDesc &td) : name(name), td(td
 DbFile::~DbFile() {
     // TODO pa1: close file
     // Hind: use close
+    unmap();
     close(fd);
 }
 
 const std::string &DbFile::getName() const { return name; }
 
-void DbFile::readPage(Page &page, const size_t id) const {
-    reads.push_back(id);
+uint32_t DbFile::getId() const { return id; }
+
+size_t DbFile::getPageSize() const { return page_size; }
+
+off_t DbFile::offset(size_t id) const { return static_cast<off_t>(base + id * page_size); }
+
+void DbFile::readPage(std::span<uint8_t> page, const size_t id) const {
+    if (page.size() < page_size) {
+        throw std::invalid_argument("The buffer is smaller than a page");
+    }
+    {
+        std::lock_guard lock(log_mutex);
+        reads.push_back(id);
+    }
     // TODO pa1: read page
     // Hint: use pread
-    std::fill(page.begin(), page.end(), 0);
-    pread(fd, page.data(), DEFAULT_PAGE_SIZE, id * DEFAULT_PAGE_SIZE);
+    std::fill(page.begin(), page.begin() + page_size, 0);
+    if (direct && !aligned(page.data())) {
+        Bounce bounce(page_size);
+        ssize_t n = pread(fd, bounce.data(), page_size, offset(id));
+        std::copy(bounce.data(), bounce.data() + std::max<ssize_t>(n, 0), page.data());
+        return;
+    }
+    pread(fd, page.data(), page_size, offset(id));
 }
 
-void DbFile::writePage(const Page &page, const size_t id) const {
-    writes.push_back(id);
+void DbFile::writePage(std::span<const uint8_t> page, const size_t id) const {
+    if (page.size() < page_size) {
+        throw std::invalid_argument("The buffer is smaller than a page");
+    }
+    {
+        std::lock_guard lock(log_mutex);
+        writes.push_back(id);
+    }
     // TODO pa1: write page
     // Hint: use pwrite
-    pwrite(fd, page.data(), DEFAULT_PAGE_SIZE, id * DEFAULT_PAGE_SIZE);
+    if (direct && !aligned(page.data())) {
+        Bounce bounce(page_size);
+        std::copy(page.begin(), page.begin() + page_size, bounce.data());
+        pwrite(fd, bounce.data(), page_size, offset(id));
+        return;
+    }
+    pwrite(fd, page.data(), page_size, offset(id));
+}
+
+void DbFile::writePages(std::span<const uint8_t *const> pages, const size_t first) const {
+    if (direct && !std::all_of(pages.begin(), pages.end(), aligned)) {
+        for (size_t i = 0; i < pages.size(); ++i) {
+            writePage({pages[i], page_size}, first + i);
+        }
+        return;
+    }
+    {
+        std::lock_guard lock(log_mutex);
+        for (size_t i = 0; i < pages.size(); ++i) {
+            writes.push_back(first + i);
+        }
+    }
+    std::vector<iovec> iov;
+    iov.reserve(pages.size());
+    for (const uint8_t *page: pages) {
+        iov.push_back({const_cast<uint8_t *>(page), page_size});
+    }
+    // pwritev takes at most IOV_MAX buffers and may write less than asked for.
+    size_t done = 0;
+    size_t bytes = 0;
+    while (done < iov.size()) {
+        int count = static_cast<int>(std::min<size_t>(iov.size() - done, IOV_MAX));
+        ssize_t n = pwritev(fd, iov.data() + done, count, offset(first) + static_cast<off_t>(bytes));
+        if (n <= 0) {
+            throw std::runtime_error("pwritev");
+        }
+        bytes += n;
+        while (done < iov.size() && n >= static_cast<ssize_t>(iov[done].iov_len)) {
+            n -= static_cast<ssize_t>(iov[done].iov_len);
+            ++done;
+        }
+        if (n > 0) {
+            iov[done].iov_base = static_cast<uint8_t *>(iov[done].iov_base) + n;
+            iov[done].iov_len -= n;
+        }
+    }
+}
+
+IoRequest DbFile::readRequest(std::span<uint8_t> page, const size_t id) const {
+    if (page.size() < page_size) {
+        throw std::invalid_argument("The buffer is smaller than a page");
+    }
+    if (direct && !aligned(page.data())) {
+        throw std::invalid_argument("Direct I/O needs an aligned page");
+    }
+    {
+        std::lock_guard lock(log_mutex);
+        reads.push_back(id);
+    }
+    std::fill(page.begin(), page.begin() + page_size, 0);
+    return {IoOp::READ, fd, page.data(), page_size, offset(id)};
+}
+
+IoRequest DbFile::writeRequest(std::span<const uint8_t> page, const size_t id) const {
+    if (page.size() < page_size) {
+        throw std::invalid_argument("The buffer is smaller than a page");
+    }
+    if (direct && !aligned(page.data())) {
+        throw std::invalid_argument("Direct I/O needs an aligned page");
+    }
+    {
+        std::lock_guard lock(log_mutex);
+        writes.push_back(id);
+    }
+    return {IoOp::WRITE, fd, const_cast<uint8_t *>(page.data()), page_size, offset(id)};
+}
+
+void DbFile::map() {
+    if (mapping) {
+        return;
+    }
+    BufferPool &bufferPool = getDatabase().getBufferPool();
+    bufferPool.flushFile(name);
+    bufferPool.discardFile(name);
+    struct stat st{};
+    if (fstat(fd, &st) == -1) {
+        throw std::runtime_error("fstat");
+    }
+    // Only whole pages are mapped: reading past the end of the file through a mapping raises SIGBUS, so a partial
+    // page at the end is left to the BufferPool, which reads it zero-padded.
+    size_t pages = static_cast<size_t>(st.st_size) > base ? (st.st_size - base) / page_size : 0;
+    if (pages == 0) {
+        return; // A file without a whole page has nothing to map.
+    }
+    size_t size = base + pages * page_size;
+    void *memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("mmap");
+    }
+    madvise(memory, size, MADV_SEQUENTIAL);
+    mapping = static_cast<const uint8_t *>(memory);
+    mapped_pages = pages;
+}
+
+void DbFile::unmap() {
+    if (mapping) {
+        munmap(const_cast<uint8_t *>(mapping), base + mapped_pages * page_size);
+    }
+    mapping = nullptr;
+    mapped_pages = 0;
+}
+
+void DbFile::setDirect(bool direct) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, direct ? flags | O_DIRECT : flags & ~O_DIRECT) == -1) {
+        throw std::runtime_error("fcntl");
+    }
+    this->direct = direct;
+}
+
+bool DbFile::isDirect() const { return direct; }
+
+bool DbFile::isMapped() const { return mapping != nullptr; }
+
+void DbFile::checkWritable() const {
+    if (isMapped()) {
+        throw std::logic_error("Cannot modify a mapped file");
+    }
+}
+
+PageGuard DbFile::pinForRead(const size_t id) const {
+    if (id < mapped_pages) {
+        return PageGuard({mapping + offset(id), page_size});
+    }
+    return getDatabase().getBufferPool().pin({this->id, id});
 }
 
 const std::vector<size_t> &DbFile::getReads() const { return reads; }
@@ -61,6 +280,15 @@ Tuple DbFile::getTuple(const Iterator &it) const { throw std::runtime_error("Not
 
 void DbFile::next(Iterator &it) const { throw std::runtime_error("Not implemented"); }
 
+void DbFile::readBatch(Iterator &it, Batch &batch) const {
+    batch.clear();
+    const Iterator last = end();
+    while (it != last && batch.size() < BATCH_SIZE) {
+        batch.append(getTuple(it));
+        next(it);
+    }
+}
+
 Iterator DbFile::begin() const { throw std::runtime_error("Not implemented"); }
 
 Iterator DbFile::end() const { throw std::runtime_error("Not implemented"); }
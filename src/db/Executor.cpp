@@ -0,0 +1,380 @@
+#include <db/Accumulator.hpp>
+#include <db/BTreeFile.hpp>
+#include <db/Database.hpp>
+#include <db/Executor.hpp>
+#include <db/HeapFile.hpp>
+#include <db/HeapPage.hpp>
+#include <db/Kernels.hpp>
+#include <db/LeafPage.hpp>
+#include <db/Operator.hpp>
+#include <db/TempFile.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <numeric>
+#include <thread>
+
+using namespace db;
+
+Executor::Executor(size_t workers)
+        : workers(workers != 0 ? workers : std::max<size_t>(std::thread::hardware_concurrency(), 1)) {}
+
+size_t Executor::getWorkers() const { return workers; }
+
+size_t Executor::scan(const DbFile &file, const std::vector<FilterPredicate> &pred,
+                      const std::function<void(size_t, size_t, Batch &)> &task,
+                      const std::function<void(size_t)> &merge) const {
+    const TupleDesc &td = file.getTupleDesc();
+    const auto *heap = dynamic_cast<const HeapFile *>(&file);
+    const auto *tree = dynamic_cast<const BTreeFile *>(&file);
+    if (heap == nullptr && tree == nullptr) {
+        ScanOperator op(file, pred);
+        Batch batch;
+        op.open();
+        while (op.next(batch)) task(0, 0, batch);
+        op.close();
+        if (merge) merge(0);
+        return 1;
+    }
+
+    std::vector<size_t> pages;
+    if (tree != nullptr) {
+        pages = tree->leaves();
+    } else {
+        pages.resize(file.getNumPages());
+        std::iota(pages.begin(), pages.end(), 0);
+    }
+    // Workers read the file directly, so it must hold the latest version of every page.
+    getDatabase().getBufferPool().flushFile(file.getName());
+    size_t n = (pages.size() + MORSEL_PAGES - 1) / MORSEL_PAGES;
+    if (n == 0) return 0;
+
+    // The page kernels evaluate the predicates they support before decoding; the rest run on the decoded batch.
+    std::vector<size_t> indices, kernel, residual;
+    for (size_t i = 0; i < pred.size(); ++i) {
+        indices.push_back(td.index_of(pred[i].field_name));
+        type_t type = td.type_of(indices.back());
+        bool supported = (type == type_t::INT && std::holds_alternative<int>(pred[i].value)) ||
+                         (type == type_t::DOUBLE && std::holds_alternative<double>(pred[i].value));
+        (heap != nullptr && supported ? kernel : residual).push_back(i);
+    }
+
+    auto runMorsel = [&](size_t worker, size_t m) {
+        std::vector<uint8_t> page(file.getPageSize());
+        Batch batch(td);
+        std::vector<uint8_t> mask, sel;
+        auto emit = [&] {
+            if (!residual.empty()) {
+                sel.assign(batch.size(), 1);
+                for (size_t i: residual) select_column(batch.column(indices[i]), pred[i].op, pred[i].value, sel);
+                batch.select(sel);
+            }
+            if (batch.size() > 0) task(worker, m, batch);
+            batch = Batch(td);
+        };
+        for (size_t p = m * MORSEL_PAGES; p < std::min(pages.size(), (m + 1) * MORSEL_PAGES); ++p) {
+            file.readPage(page, pages[p]);
+            if (tree != nullptr) {
+                const LeafPage leaf(page, td, tree->getKeyIndex());
+                for (size_t slot = 0; slot < leaf.header->size; ++slot) {
+                    batch.append(leaf.data + slot * td.length(), td);
+                    if (batch.size() == BATCH_SIZE) emit();
+                }
+                continue;
+            }
+            const HeapPage hp(page, td);
+            mask.assign(hp.occupancy(), hp.occupancy() + (hp.end() + 7) / 8);
+            for (size_t i: kernel) {
+                if (const int *v = std::get_if<int>(&pred[i].value)) {
+                    select_int(hp.field(indices[i]), td.length(), hp.end(), pred[i].op, *v, mask.data());
+                } else {
+                    select_double(hp.field(indices[i]), td.length(), hp.end(), pred[i].op,
+                                  std::get<double>(pred[i].value), mask.data());
+                }
+            }
+            for (size_t slot = 0; slot < hp.end(); ++slot) {
+                if (!(mask[slot / 8] & (1 << (7 - slot % 8)))) continue;
+                hp.getTuple(slot, batch);
+                if (batch.size() == BATCH_SIZE) emit();
+            }
+        }
+        emit();
+    };
+
+    // Each worker owns a contiguous range of morsels and steals from the front of the others once it is done.
+    struct Range {
+        std::atomic<size_t> next{0};
+        size_t end = 0;
+    };
+    size_t w = std::min(workers, n);
+    std::vector<Range> ranges(w);
+    for (size_t i = 0; i < w; ++i) {
+        ranges[i].next = i * n / w;
+        ranges[i].end = (i + 1) * n / w;
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<bool> done(n);
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    auto fail = [&](std::exception_ptr e) {
+        std::lock_guard lock(mutex);
+        if (!error) error = std::move(e);
+        failed = true;
+        cv.notify_all();
+    };
+    auto work = [&](size_t worker) {
+        for (size_t v = 0; v < w && !failed; ++v) {
+            Range &range = ranges[(worker + v) % w];
+            for (size_t m; !failed && (m = range.next.fetch_add(1)) < range.end;) {
+                try {
+                    runMorsel(worker, m);
+                } catch (...) {
+                    fail(std::current_exception());
+                    return;
+                }
+                std::lock_guard lock(mutex);
+                done[m] = true;
+                cv.notify_all();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(w);
+    for (size_t i = 0; i < w; ++i) threads.emplace_back(work, i);
+    for (size_t m = 0; m < n; ++m) {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [&] { return done[m] || failed; });
+        if (failed) break;
+        lock.unlock();
+        if (!merge) continue;
+        try {
+            merge(m);
+        } catch (...) {
+            fail(std::current_exception());
+            break;
+        }
+    }
+    for (auto &t: threads) t.join();
+    if (error) std::rethrow_exception(error);
+    return n;
+}
+
+// Scans in with the predicates, transforms every batch on the workers and inserts the results in morsel order.
+static void scanInto(const Executor &executor, const DbFile &in, DbFile &out, const std::vector<FilterPredicate> &pred,
+                     const std::function<void(Batch &)> &transform) {
+    std::mutex mutex;
+    std::map<size_t, std::vector<Batch>> results;
+    executor.scan(in, pred, [&](size_t, size_t m, Batch &batch) {
+        transform(batch);
+        std::lock_guard lock(mutex);
+        results[m].push_back(std::move(batch));
+    }, [&](size_t m) {
+        std::vector<Batch> batches;
+        {
+            std::lock_guard lock(mutex);
+            auto pos = results.find(m);
+            if (pos == results.end()) return;
+            batches = std::move(pos->second);
+            results.erase(pos);
+        }
+        for (const auto &batch: batches) {
+            for (size_t row = 0; row < batch.size(); ++row) out.insertTuple(batch.get_tuple(row));
+        }
+    });
+}
+
+void Executor::filter(const DbFile &in, DbFile &out, const std::vector<FilterPredicate> &pred) const {
+    scanInto(*this, in, out, pred, [](Batch &) {});
+}
+
+void Executor::projection(const DbFile &in, DbFile &out, const std::vector<std::string> &field_names,
+                          const std::vector<FilterPredicate> &pred) const {
+    std::vector<size_t> indices;
+    for (const auto &name: field_names) indices.push_back(in.getTupleDesc().index_of(name));
+    scanInto(*this, in, out, pred, [&](Batch &batch) { batch.project(indices); });
+}
+
+// Runs fn(worker, i) for every i < n on the given number of threads, handing out indices one at a time.
+static void parallelFor(size_t n, size_t workers, const std::function<void(size_t, size_t)> &fn) {
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < std::min(workers, n); ++w) {
+        threads.emplace_back([&, w] {
+            for (size_t i; !failed && (i = next.fetch_add(1)) < n;) {
+                try {
+                    fn(w, i);
+                } catch (...) {
+                    std::lock_guard lock(mutex);
+                    if (!error) error = std::current_exception();
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (auto &t: threads) t.join();
+    if (error) std::rethrow_exception(error);
+}
+
+void Executor::join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred) const {
+    if (pred.op != PredicateOp::EQ) {
+        throw std::logic_error("Hash join requires an equality predicate");
+    }
+    size_t lidx = left.getTupleDesc().index_of(pred.left);
+    size_t ridx = right.getTupleDesc().index_of(pred.right);
+    bool buildLeft = left.getNumPages() < right.getNumPages();
+    const DbFile &build = buildLeft ? left : right;
+    const DbFile &probe = buildLeft ? right : left;
+    size_t bidx = buildLeft ? lidx : ridx;
+    size_t pidx = buildLeft ? ridx : lidx;
+
+    // Partition the build side into buffers owned by each worker.
+    size_t n = workers * 4;
+    std::vector<std::vector<std::vector<Tuple>>> local(workers, std::vector<std::vector<Tuple>>(n));
+    scan(build, {}, [&](size_t worker, size_t, Batch &batch) {
+        for (size_t row = 0; row < batch.size(); ++row) {
+            size_t part = partition_of(std::hash<field_t>()(batch.get_field(row, bidx)), 0, n);
+            local[worker][part].push_back(batch.get_tuple(row));
+        }
+    });
+
+    // Build one hash table per partition, each by a single worker.
+    struct Partition {
+        std::vector<Tuple> rows;
+        std::unordered_multimap<field_t, size_t> index;
+    };
+    std::vector<Partition> parts(n);
+    parallelFor(n, workers, [&](size_t, size_t part) {
+        Partition &p = parts[part];
+        for (auto &buffers: local) {
+            for (auto &t: buffers[part]) {
+                p.index.emplace(t.get_field(bidx), p.rows.size());
+                p.rows.push_back(std::move(t));
+            }
+            buffers[part].clear();
+        }
+    });
+
+    // Probe the read-only tables from morsels of the other input.
+    const TupleDesc &td = out.getTupleDesc();
+    scanInto(*this, probe, out, {}, [&](Batch &batch) {
+        Batch joined(td);
+        std::vector<field_t> fields;
+        for (size_t row = 0; row < batch.size(); ++row) {
+            field_t key = batch.get_field(row, pidx);
+            const Partition &p = parts[partition_of(std::hash<field_t>()(key), 0, n)];
+            auto [first, last] = p.index.equal_range(key);
+            if (first == last) continue;
+            const Tuple pt = batch.get_tuple(row);
+            for (auto match = first; match != last; ++match) {
+                const Tuple &bt = p.rows[match->second];
+                const Tuple &lt = buildLeft ? bt : pt;
+                const Tuple &rt = buildLeft ? pt : bt;
+                fields.clear();
+                for (size_t i = 0; i < lt.size(); ++i) fields.push_back(lt.get_field(i));
+                for (size_t i = 0; i < rt.size(); ++i) {
+                    if (i != ridx) fields.push_back(rt.get_field(i));
+                }
+                joined.append(Tuple(fields));
+            }
+        }
+        batch = std::move(joined);
+    });
+}
+
+void Executor::aggregate(const DbFile &in, DbFile &out, const GroupBy &agg,
+                         const std::vector<FilterPredicate> &pred) const {
+    if (agg.aggregates.empty()) {
+        throw std::logic_error("At least one aggregate is required");
+    }
+    const TupleDesc &td = in.getTupleDesc();
+    std::vector<size_t> grpIdx;
+    for (const auto &g: agg.groups) grpIdx.push_back(td.index_of(g));
+    std::vector<std::pair<AggregateOp, size_t>> aggs;
+    for (const auto &a: agg.aggregates) aggs.emplace_back(a.op, td.index_of(a.field));
+
+    // A group remembers the (morsel, position) of its first tuple, so the merged groups can be emitted in the order a
+    // sequential scan first sees them. A worker that steals may scan a morsel before the one it took last, so the
+    // position is kept as the minimum over every tuple of the group.
+    struct Group {
+        std::vector<field_t> key;
+        std::vector<Accumulator> accs;
+        std::pair<size_t, size_t> first;
+    };
+    struct Partial {
+        std::unordered_map<std::vector<field_t>, size_t, KeyHash> index;
+        std::vector<Group> groups;
+        size_t morsel = SIZE_MAX;
+        size_t seen = 0;
+    };
+    std::vector<Partial> partials(workers);
+
+    scan(in, pred, [&](size_t worker, size_t m, Batch &batch) {
+        Partial &p = partials[worker];
+        if (p.morsel != m) {
+            p.morsel = m;
+            p.seen = 0;
+        }
+        auto group = [&](const std::vector<field_t> &key, size_t row) {
+            std::pair<size_t, size_t> at{m, p.seen + row};
+            auto [pos, inserted] = p.index.emplace(key, p.groups.size());
+            if (inserted) {
+                std::vector<Accumulator> accs;
+                for (const auto &[op, v]: aggs) accs.emplace_back(op);
+                p.groups.push_back({key, std::move(accs), at});
+            } else {
+                Group &g = p.groups[pos->second];
+                g.first = std::min(g.first, at);
+            }
+            return pos->second;
+        };
+
+        if (grpIdx.empty()) {
+            auto &accs = p.groups[group({}, 0)].accs;
+            for (size_t a = 0; a < aggs.size(); ++a) {
+                std::visit([&](const auto &values) { accs[a].addAll(values); }, batch.column(aggs[a].second));
+            }
+        } else {
+            std::vector<size_t> gids(batch.size());
+            std::vector<field_t> key;
+            for (size_t row = 0; row < batch.size(); ++row) {
+                key.clear();
+                for (size_t g: grpIdx) key.push_back(batch.get_field(row, g));
+                gids[row] = group(key, row);
+            }
+            for (size_t a = 0; a < aggs.size(); ++a) {
+                std::visit([&](const auto &values) {
+                    for (size_t row = 0; row < values.size(); ++row) p.groups[gids[row]].accs[a].add(values[row]);
+                }, batch.column(aggs[a].second));
+            }
+        }
+        p.seen += batch.size();
+    });
+
+    Partial merged;
+    for (auto &p: partials) {
+        for (auto &g: p.groups) {
+            auto [pos, inserted] = merged.index.emplace(g.key, merged.groups.size());
+            if (inserted) {
+                merged.groups.push_back(std::move(g));
+                continue;
+            }
+            Group &into = merged.groups[pos->second];
+            for (size_t a = 0; a < aggs.size(); ++a) into.accs[a].merge(g.accs[a]);
+            into.first = std::min(into.first, g.first);
+        }
+        p = Partial();
+    }
+    std::sort(merged.groups.begin(), merged.groups.end(),
+              [](const Group &a, const Group &b) { return a.first < b.first; });
+    for (const auto &g: merged.groups) {
+        std::vector<field_t> fields(g.key);
+        for (const auto &acc: g.accs) fields.push_back(acc.result());
+        out.insertTuple(Tuple(fields));
+    }
+}
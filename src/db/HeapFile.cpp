@@ -3,57 +3,162 @@
 #include <db/HeapPage.hpp>
 #include <stdexcept>
 #include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace db;
 
-HeapFile::HeapFile(const std::string &name, const TupleDesc &td) : DbFile(name, td) {}
+namespace {
+    // The bytes of the side file of the free-space map. The pages past its end or in a hole of it are not recorded.
+    enum : uint8_t {
+        UNRECORDED = 0, FULL = 1, HAS_ROOM = 2
+    };
+} // namespace
+
+HeapFile::HeapFile(const std::string &name, const TupleDesc &td, size_t page_size) : DbFile(name, td, page_size) {
+    std::string path = name + FREE_SPACE_MAP_SUFFIX;
+    fsm = open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fsm == -1) {
+        throw std::runtime_error("open");
+    }
+    struct stat st{};
+    if (stat(name.c_str(), &st) == -1) {
+        close(fsm);
+        throw std::runtime_error("stat");
+    }
+    if (st.st_size <= static_cast<off_t>(base)) {
+        // A new file: whatever is left of the map of a deleted file with the same name does not describe it.
+        if (ftruncate(fsm, 0) == -1) {
+            close(fsm);
+            throw std::runtime_error("ftruncate");
+        }
+        try {
+            record(0, false);
+        } catch (...) {
+            close(fsm);
+            throw;
+        }
+        addFreePage(0);
+        return;
+    }
+    std::vector<uint8_t> bytes(numPages, UNRECORDED);
+    if (pread(fsm, bytes.data(), bytes.size(), 0) == -1) {
+        close(fsm);
+        throw std::runtime_error("pread");
+    }
+    // The last page goes on top, so that a file without deletes is filled in order.
+    for (size_t page = 0; page < numPages; ++page) {
+        if (bytes[page] == HAS_ROOM) {
+            addFreePage(page);
+        } else if (bytes[page] != FULL) {
+            unrecorded.push_back(page);
+        }
+    }
+}
+
+HeapFile::~HeapFile() { close(fsm); }
 
 void HeapFile::insertTuple(const Tuple &t) {
     // TODO pa1
     if (!td.compatible(t)) {
         throw std::runtime_error("Tuple not compatible with TupleDesc");
     }
+    checkWritable();
     BufferPool &bufferPool = getDatabase().getBufferPool();
-    PageId pid{name, 0};
-    pid.page = numPages - 1;
-    Page &p = bufferPool.getPage(pid);
-    HeapPage hp(p, td);
-    if (!hp.insertTuple(t)) {
-        numPages++;
-        pid.page++;
-        Page &np = bufferPool.getPage(pid);
-        HeapPage nhp(np, td);
-        nhp.insertTuple(t);
-    }
-    bufferPool.markDirty(pid);
+    // A page leaves the map once an insert fills it. A page the map took for one with a free slot may be full: it is
+    // dropped when an insert finds it full.
+    while (!free_pages.empty() || mapFreeSpace()) {
+        size_t page = free_pages.back();
+        PageGuard guard = bufferPool.pin({id, page}, Latch::EXCLUSIVE);
+        HeapPage hp(guard.page(), td);
+        bool inserted = hp.insertTuple(t);
+        if (inserted) {
+            guard.markDirty();
+        }
+        if (!inserted || hp.full()) {
+            free_pages.pop_back();
+            listed[page] = false;
+            record(page, true);
+        }
+        if (inserted) {
+            return;
+        }
+    }
+    PageId pid{id, numPages++};
+    PageGuard guard = bufferPool.pin(pid, Latch::EXCLUSIVE);
+    HeapPage hp(guard.page(), td);
+    hp.insertTuple(t);
+    guard.markDirty();
+    if (!hp.full()) {
+        addFreePage(pid.page);
+    }
+    record(pid.page, hp.full());
+}
+
+// Reads the pages the side file does not record from the last one back, stopping at the first with a free slot.
+// Returns whether one was found.
+bool HeapFile::mapFreeSpace() {
+    while (!unrecorded.empty()) {
+        size_t page = unrecorded.back();
+        unrecorded.pop_back();
+        PageGuard guard = pinForRead(page);
+        bool full = HeapPage(guard.page(), td).full();
+        record(page, full);
+        if (!full) {
+            addFreePage(page);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns whether the page was not in the map yet.
+bool HeapFile::addFreePage(size_t page) {
+    if (listed.size() <= page) {
+        listed.resize(page + 1);
+    }
+    if (listed[page]) {
+        return false;
+    }
+    listed[page] = true;
+    free_pages.push_back(page);
+    return true;
+}
+
+void HeapFile::record(size_t page, bool full) {
+    uint8_t byte = full ? FULL : HAS_ROOM;
+    if (pwrite(fsm, &byte, 1, static_cast<off_t>(page)) != 1) {
+        throw std::runtime_error("pwrite");
+    }
 }
 
 void HeapFile::deleteTuple(const Iterator &it) {
     // TODO pa1
+    checkWritable();
     BufferPool &bufferPool = getDatabase().getBufferPool();
-    PageId pid{name, it.page};
-    Page &p = bufferPool.getPage(pid);
-    HeapPage hp(p, td);
-    bufferPool.markDirty(pid);
+    PageId pid{id, it.page};
+    PageGuard guard = bufferPool.pin(pid, Latch::EXCLUSIVE);
+    HeapPage hp(guard.page(), td);
+    guard.markDirty();
     hp.deleteTuple(it.slot);
+    if (addFreePage(it.page)) {
+        record(it.page, false);
+    }
 }
 
 Tuple HeapFile::getTuple(const Iterator &it) const {
     // TODO pa1
-    BufferPool &bufferPool = getDatabase().getBufferPool();
-    PageId pid{name, it.page};
-    Page &p = bufferPool.getPage(pid);
-    HeapPage hp(p, td);
+    PageGuard guard = pinForRead(it.page);
+    HeapPage hp(guard.page(), td);
     return hp.getTuple(it.slot);
 }
 
 void HeapFile::next(Iterator &it) const {
     // TODO pa1
-    BufferPool &bufferPool = getDatabase().getBufferPool();
     if (it.page < numPages) {
-        PageId pid{name, it.page};
-        Page &p = bufferPool.getPage(pid);
-        const HeapPage hp(p, td);
+        PageGuard guard = pinForRead(it.page);
+        const HeapPage hp(guard.page(), td);
         hp.next(it.slot);
         if (it.slot != hp.end()) {
             return;
@@ -61,9 +166,8 @@ void HeapFile::next(Iterator &it) const {
         it.page++;
     }
     while (it.page < numPages) {
-        PageId pid{name, it.page};
-        Page &p = bufferPool.getPage(pid);
-        const HeapPage hp(p, td);
+        PageGuard guard = pinForRead(it.page);
+        const HeapPage hp(guard.page(), td);
         it.slot = hp.begin();
         if (it.slot != hp.end()) {
             return;
@@ -73,14 +177,31 @@ void HeapFile::next(Iterator &it) const {
     it.slot = 0;
 }
 
+void HeapFile::readBatch(Iterator &it, Batch &batch) const {
+    batch.clear();
+    while (it.page < numPages && batch.size() < BATCH_SIZE) {
+        PageGuard guard = pinForRead(it.page);
+        const HeapPage hp(guard.page(), td);
+        size_t last = it.slot;
+        for (; it.slot != hp.end() && batch.size() < BATCH_SIZE; hp.next(it.slot)) {
+            hp.getTuple(it.slot, batch);
+            last = it.slot;
+        }
+        guard.release();
+        if (it.slot == hp.end()) {
+            // Let next() find the first tuple of the following non-empty page.
+            it.slot = last;
+            next(it);
+        }
+    }
+}
+
 Iterator HeapFile::begin() const {
     // TODO pa1
-    BufferPool &bufferPool = getDatabase().getBufferPool();
     size_t page = 0;
     while (page < numPages) {
-        PageId pid{name, page};
-        Page &p = bufferPool.getPage(pid);
-        const HeapPage hp(p, td);
+        PageGuard guard = pinForRead(page);
+        const HeapPage hp(guard.page(), td);
         size_t slot = hp.begin();
         if (slot != hp.end())
             return {*this, page, slot};
@@ -6,12 +6,12 @@
 
 using namespace db;
 
-HeapPage::HeapPage(Page &page, const TupleDesc &td) : td(td) {
+HeapPage::HeapPage(std::span<uint8_t> page, const TupleDesc &td) : td(td) {
     // TODO pa1
     // NOTE: header and data should point to locations inside the page buffer. Do not allocate extra memory.
-    capacity = DEFAULT_PAGE_SIZE * 8 / (td.length() * 8 + 1);
+    capacity = page.size() * 8 / (td.length() * 8 + 1);
     header = page.data();
-    data = header + DEFAULT_PAGE_SIZE - td.length() * capacity;
+    data = header + page.size() - td.length() * capacity;
 }
 
 size_t HeapPage::begin() const {
@@ -64,11 +64,40 @@ Tuple HeapPage::getTuple(size_t slot) const {
     return td.deserialize(slotData);
 }
 
+void HeapPage::getTuple(size_t slot, Batch &batch) const {
+    if (empty(slot)) {
+        throw std::runtime_error("Slot not occupied");
+    }
+    batch.append(data + slot * td.length(), td);
+}
+
+const uint8_t *HeapPage::occupancy() const {
+    return header;
+}
+
+const uint8_t *HeapPage::field(size_t index) const {
+    return data + td.offset_of(index);
+}
+
 void HeapPage::next(size_t &slot) const {
     // TODO pa1
     while (++slot < capacity && empty(slot));
 }
 
+bool HeapPage::full() const {
+    for (size_t i = 0; i < capacity / 8; ++i) {
+        if (header[i] != 0xff) {
+            return false;
+        }
+    }
+    for (size_t slot = capacity / 8 * 8; slot < capacity; ++slot) {
+        if (empty(slot)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool HeapPage::empty(size_t slot) const {
     // TODO pa1
     return !(header[slot / 8] & (1 << (7 - slot % 8)));
@@ -0,0 +1,186 @@
+#include <db/IoQueue.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+#ifdef DB_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace db;
+
+#ifdef DB_IO_URING
+namespace {
+    // The ring indices are shared with the kernel: read the ones it writes with acquire, publish ours with release.
+    unsigned load(unsigned *index) { return std::atomic_ref(*index).load(std::memory_order_acquire); }
+
+    void store(unsigned *index, unsigned value) { std::atomic_ref(*index).store(value, std::memory_order_release); }
+
+    void *map(int fd, size_t size, off_t offset) {
+        void *ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        return ring == MAP_FAILED ? nullptr : ring;
+    }
+
+    unsigned *at(void *ring, uint32_t offset) { return reinterpret_cast<unsigned *>(static_cast<char *>(ring) + offset); }
+
+    // IORING_OP_READ and IORING_OP_WRITE came with Linux 5.6, like the probe: older kernels set up a ring but fail
+    // every request of a batch with -EINVAL.
+    bool supportsReadWrite(int fd) {
+        constexpr unsigned ops = 256;
+        alignas(io_uring_probe) uint8_t buffer[sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op)]{};
+        auto *probe = reinterpret_cast<io_uring_probe *>(buffer);
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, ops) < 0) {
+            return false;
+        }
+        auto supported = [&](unsigned op) {
+            return op <= probe->last_op && op < probe->ops_len && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        };
+        return supported(IORING_OP_READ) && supported(IORING_OP_WRITE);
+    }
+} // namespace
+#endif
+
+IoQueue::IoQueue(unsigned depth) {
+#ifdef DB_IO_URING
+    io_uring_params params{};
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, std::max(depth, 1u), &params));
+    if (fd < 0) {
+        return; // Not supported by the kernel or not allowed: run the batches synchronously.
+    }
+    if (!supportsReadWrite(fd)) {
+        close(fd);
+        return;
+    }
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sq_ring = map(fd, sq_ring_size, IORING_OFF_SQ_RING);
+    cq_ring = params.features & IORING_FEAT_SINGLE_MMAP ? sq_ring : map(fd, cq_ring_size, IORING_OFF_CQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = map(fd, sqes_size, IORING_OFF_SQES);
+    if (!sq_ring || !cq_ring || !sqes) {
+        if (sqes) munmap(sqes, sqes_size);
+        if (cq_ring && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+        if (sq_ring) munmap(sq_ring, sq_ring_size);
+        sq_ring = cq_ring = sqes = nullptr;
+        close(fd);
+        return;
+    }
+    ring_fd = fd;
+    entries = params.sq_entries;
+    sq_head = at(sq_ring, params.sq_off.head);
+    sq_tail = at(sq_ring, params.sq_off.tail);
+    sq_mask = at(sq_ring, params.sq_off.ring_mask);
+    sq_array = at(sq_ring, params.sq_off.array);
+    cq_head = at(cq_ring, params.cq_off.head);
+    cq_tail = at(cq_ring, params.cq_off.tail);
+    cq_mask = at(cq_ring, params.cq_off.ring_mask);
+    cqes = at(cq_ring, params.cq_off.cqes);
+#else
+    (void) depth;
+#endif
+}
+
+IoQueue::~IoQueue() {
+#ifdef DB_IO_URING
+    if (ring_fd >= 0) {
+        munmap(sqes, sqes_size);
+        if (cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+        munmap(sq_ring, sq_ring_size);
+        close(ring_fd);
+    }
+#endif
+}
+
+bool IoQueue::isAsync() const { return ring_fd >= 0; }
+
+void IoQueue::run(std::span<IoRequest> requests) {
+    if (requests.empty()) {
+        return;
+    }
+    std::lock_guard lock(mutex);
+    if (ring_fd >= 0) {
+        runRing(requests);
+    } else {
+        runSync(requests);
+    }
+}
+
+void IoQueue::runSync(std::span<IoRequest> requests) {
+    for (auto &request: requests) {
+        ssize_t n = request.op == IoOp::READ ? pread(request.fd, request.data, request.length, request.offset)
+                                             : pwrite(request.fd, request.data, request.length, request.offset);
+        request.result = n < 0 ? -errno : n;
+    }
+}
+
+void IoQueue::runRing(std::span<IoRequest> requests) {
+#ifdef DB_IO_URING
+    auto *submissions = static_cast<io_uring_sqe *>(sqes);
+    auto *completions = static_cast<io_uring_cqe *>(cqes);
+    size_t queued = 0;
+    size_t completed = 0;
+    size_t in_flight = 0;
+    auto reap = [&] {
+        unsigned head = *cq_head;
+        for (unsigned end = load(cq_tail); head != end; ++head) {
+            const io_uring_cqe &cqe = completions[head & *cq_mask];
+            requests[cqe.user_data].result = cqe.res;
+            ++completed;
+            --in_flight;
+        }
+        store(cq_head, head);
+    };
+    while (completed < requests.size()) {
+        // Fill the free entries of the submission ring. Only this thread writes the tail.
+        unsigned tail = *sq_tail;
+        while (queued < requests.size() && in_flight < entries) {
+            const IoRequest &request = requests[queued];
+            unsigned index = tail & *sq_mask;
+            io_uring_sqe &sqe = submissions[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = request.op == IoOp::READ ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe.fd = request.fd;
+            sqe.addr = reinterpret_cast<uint64_t>(request.data);
+            sqe.len = static_cast<uint32_t>(request.length);
+            sqe.off = static_cast<uint64_t>(request.offset);
+            sqe.user_data = queued;
+            sq_array[index] = index;
+            ++tail;
+            ++queued;
+            ++in_flight;
+        }
+        store(sq_tail, tail);
+
+        // Hand the entries the kernel has not consumed yet over, and wait for at least one completion.
+        unsigned pending = tail - load(sq_head);
+        if (syscall(__NR_io_uring_enter, ring_fd, pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+            errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            // The caller reuses the buffers once run() throws, so first withdraw the entries the kernel has not
+            // consumed, and wait for the ones it has: until they complete, the kernel may still write to them.
+            unsigned consumed = load(sq_head);
+            in_flight -= tail - consumed;
+            store(sq_tail, consumed);
+            while (in_flight > 0) {
+                if (syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+                    errno != EINTR) {
+                    std::this_thread::yield();
+                }
+                reap();
+            }
+            throw std::runtime_error("io_uring_enter");
+        }
+        reap();
+    }
+#else
+    runSync(requests);
+#endif
+}
@@ -0,0 +1,276 @@
+#include <db/Kernels.hpp>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace db;
+
+template<typename T>
+static T load(const uint8_t *p) {
+    T x;
+    std::memcpy(&x, p, sizeof(T));
+    return x;
+}
+
+template<typename T>
+static bool test(const T &x, PredicateOp op, const T &v) {
+    switch (op) {
+        case PredicateOp::EQ:
+            return x == v;
+        case PredicateOp::NE:
+            return x != v;
+        case PredicateOp::LT:
+            return x < v;
+        case PredicateOp::LE:
+            return x <= v;
+        case PredicateOp::GT:
+            return x > v;
+        case PredicateOp::GE:
+            return x >= v;
+    }
+    return false;
+}
+
+// Evaluates the slots [i, i + count) of the column and returns them in the header bit layout.
+template<typename T>
+static uint8_t scalarByte(const uint8_t *base, size_t stride, size_t i, size_t count, PredicateOp op, T v) {
+    uint8_t bits = 0;
+    for (size_t j = 0; j < count; ++j) {
+        bits |= static_cast<uint8_t>(test(load<T>(base + (i + j) * stride), op, v)) << (7 - j);
+    }
+    return bits;
+}
+
+// Handles the slots past the last full byte, which every implementation leaves to the scalar code.
+template<typename T>
+static void selectTail(const uint8_t *base, size_t stride, size_t n, PredicateOp op, T v, uint8_t *mask) {
+    size_t i = n / 8 * 8;
+    if (i < n) mask[i / 8] &= scalarByte(base, stride, i, n - i, op, v);
+}
+
+template<typename T>
+static void selectScalar(const uint8_t *base, size_t stride, size_t n, PredicateOp op, T v, uint8_t *mask) {
+    for (size_t i = 0; i + 8 <= n; i += 8) {
+        mask[i / 8] &= scalarByte(base, stride, i, 8, op, v);
+    }
+    selectTail(base, stride, n, op, v, mask);
+}
+
+#if defined(__x86_64__)
+// The vector kernels put slot 7 of a byte in lane 0 and slot 0 in lane 7, so that the movemask of a comparison is
+// already in the header bit layout.
+
+static int compareSse2(__m128i x, __m128i v, PredicateOp op) {
+    switch (op) {
+        case PredicateOp::EQ:
+            return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, v)));
+        case PredicateOp::NE:
+            return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, v))) & 0xF;
+        case PredicateOp::LT:
+            return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(x, v)));
+        case PredicateOp::LE:
+            return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(x, v))) & 0xF;
+        case PredicateOp::GT:
+            return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(x, v)));
+        case PredicateOp::GE:
+            return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(x, v))) & 0xF;
+    }
+    return 0;
+}
+
+static int compareSse2(__m128d x, __m128d v, PredicateOp op) {
+    switch (op) {
+        case PredicateOp::EQ:
+            return _mm_movemask_pd(_mm_cmpeq_pd(x, v));
+        case PredicateOp::NE:
+            return _mm_movemask_pd(_mm_cmpneq_pd(x, v));
+        case PredicateOp::LT:
+            return _mm_movemask_pd(_mm_cmplt_pd(x, v));
+        case PredicateOp::LE:
+            return _mm_movemask_pd(_mm_cmple_pd(x, v));
+        case PredicateOp::GT:
+            return _mm_movemask_pd(_mm_cmpgt_pd(x, v));
+        case PredicateOp::GE:
+            return _mm_movemask_pd(_mm_cmpge_pd(x, v));
+    }
+    return 0;
+}
+
+// SSE2 has no gather, so the lanes are filled with scalar loads and only the comparisons are vectorized.
+static void selectSse2(const uint8_t *base, size_t stride, size_t n, PredicateOp op, int value, uint8_t *mask) {
+    const __m128i v = _mm_set1_epi32(value);
+    for (size_t i = 0; i + 8 <= n; i += 8) {
+        const uint8_t *p = base + i * stride;
+        __m128i lo = _mm_set_epi32(load<int>(p + 4 * stride), load<int>(p + 5 * stride),
+                                   load<int>(p + 6 * stride), load<int>(p + 7 * stride));
+        __m128i hi = _mm_set_epi32(load<int>(p), load<int>(p + stride),
+                                   load<int>(p + 2 * stride), load<int>(p + 3 * stride));
+        mask[i / 8] &= compareSse2(lo, v, op) | compareSse2(hi, v, op) << 4;
+    }
+    selectTail(base, stride, n, op, value, mask);
+}
+
+static void selectSse2(const uint8_t *base, size_t stride, size_t n, PredicateOp op, double value, uint8_t *mask) {
+    const __m128d v = _mm_set1_pd(value);
+    for (size_t i = 0; i + 8 <= n; i += 8) {
+        const uint8_t *p = base + i * stride;
+        int bits = 0;
+        for (size_t k = 0; k < 4; ++k) {
+            // Lanes 2k and 2k + 1 hold slots 7 - 2k and 6 - 2k.
+            __m128d x = _mm_set_pd(load<double>(p + (6 - 2 * k) * stride), load<double>(p + (7 - 2 * k) * stride));
+            bits |= compareSse2(x, v, op) << (2 * k);
+        }
+        mask[i / 8] &= bits;
+    }
+    selectTail(base, stride, n, op, value, mask);
+}
+
+__attribute__((target("avx2")))
+static int compareAvx2(__m256i x, __m256i v, PredicateOp op) {
+    switch (op) {
+        case PredicateOp::EQ:
+            return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, v)));
+        case PredicateOp::NE:
+            return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, v))) & 0xFF;
+        case PredicateOp::LT:
+            return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, x)));
+        case PredicateOp::LE:
+            return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, v))) & 0xFF;
+        case PredicateOp::GT:
+            return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, v)));
+        case PredicateOp::GE:
+            return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, x))) & 0xFF;
+    }
+    return 0;
+}
+
+__attribute__((target("avx2")))
+static int compareAvx2(__m256d x, __m256d v, PredicateOp op) {
+    switch (op) {
+        case PredicateOp::EQ:
+            return _mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_EQ_OQ));
+        case PredicateOp::NE:
+            return _mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_NEQ_UQ));
+        case PredicateOp::LT:
+            return _mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_LT_OQ));
+        case PredicateOp::LE:
+            return _mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_LE_OQ));
+        case PredicateOp::GT:
+            return _mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_GT_OQ));
+        case PredicateOp::GE:
+            return _mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_GE_OQ));
+    }
+    return 0;
+}
+
+// Eight strided slots are loaded with one gather, using byte offsets as indices.
+__attribute__((target("avx2")))
+static void selectAvx2(const uint8_t *base, size_t stride, size_t n, PredicateOp op, int value, uint8_t *mask) {
+    const int s = static_cast<int>(stride);
+    const __m256i idx = _mm256_setr_epi32(7 * s, 6 * s, 5 * s, 4 * s, 3 * s, 2 * s, s, 0);
+    const __m256i v = _mm256_set1_epi32(value);
+    for (size_t i = 0; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_i32gather_epi32(reinterpret_cast<const int *>(base + i * stride), idx, 1);
+        mask[i / 8] &= compareAvx2(x, v, op);
+    }
+    selectTail(base, stride, n, op, value, mask);
+}
+
+__attribute__((target("avx2")))
+static void selectAvx2(const uint8_t *base, size_t stride, size_t n, PredicateOp op, double value, uint8_t *mask) {
+    const int s = static_cast<int>(stride);
+    const __m128i lo = _mm_setr_epi32(7 * s, 6 * s, 5 * s, 4 * s);
+    const __m128i hi = _mm_setr_epi32(3 * s, 2 * s, s, 0);
+    const __m256d v = _mm256_set1_pd(value);
+    for (size_t i = 0; i + 8 <= n; i += 8) {
+        const auto *p = reinterpret_cast<const double *>(base + i * stride);
+        int bits = compareAvx2(_mm256_i32gather_pd(p, lo, 1), v, op);
+        bits |= compareAvx2(_mm256_i32gather_pd(p, hi, 1), v, op) << 4;
+        mask[i / 8] &= bits;
+    }
+    selectTail(base, stride, n, op, value, mask);
+}
+#endif
+
+SimdLevel db::detect_simd_level() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+static std::atomic<SimdLevel> &currentLevel() {
+    static std::atomic<SimdLevel> level{detect_simd_level()};
+    return level;
+}
+
+SimdLevel db::simd_level() {
+    return currentLevel().load(std::memory_order_relaxed);
+}
+
+SimdLevel db::set_simd_level(SimdLevel level) {
+    level = std::min(level, detect_simd_level());
+    currentLevel().store(level, std::memory_order_relaxed);
+    return level;
+}
+
+template<typename T>
+static void select(const uint8_t *base, size_t stride, size_t n, PredicateOp op, T value, uint8_t *mask) {
+#if defined(__x86_64__)
+    // The gather indices are 32-bit byte offsets of up to 7 strides.
+    switch (stride <= INT_MAX / 8 ? simd_level() : SimdLevel::SCALAR) {
+        case SimdLevel::AVX2:
+            return selectAvx2(base, stride, n, op, value, mask);
+        case SimdLevel::SSE2:
+            return selectSse2(base, stride, n, op, value, mask);
+        case SimdLevel::SCALAR:
+            break;
+    }
+#endif
+    selectScalar(base, stride, n, op, value, mask);
+}
+
+void db::select_int(const uint8_t *base, size_t stride, size_t n, PredicateOp op, int value, uint8_t *mask) {
+    select(base, stride, n, op, value, mask);
+}
+
+void db::select_double(const uint8_t *base, size_t stride, size_t n, PredicateOp op, double value, uint8_t *mask) {
+    select(base, stride, n, op, value, mask);
+}
+
+// Clears the selection of the rows whose value does not satisfy op against v.
+// Every case is a branch-free loop over a primitive array, which the compiler can vectorize.
+template<typename T>
+static void selectColumn(const std::vector<T> &col, PredicateOp op, const T &v, std::vector<uint8_t> &sel) {
+    const T *x = col.data();
+    uint8_t *s = sel.data();
+    size_t n = col.size();
+    switch (op) {
+        case PredicateOp::EQ: for (size_t i = 0; i < n; ++i) s[i] &= x[i] == v; break;
+        case PredicateOp::NE: for (size_t i = 0; i < n; ++i) s[i] &= x[i] != v; break;
+        case PredicateOp::GT: for (size_t i = 0; i < n; ++i) s[i] &= x[i] > v; break;
+        case PredicateOp::GE: for (size_t i = 0; i < n; ++i) s[i] &= x[i] >= v; break;
+        case PredicateOp::LT: for (size_t i = 0; i < n; ++i) s[i] &= x[i] < v; break;
+        case PredicateOp::LE: for (size_t i = 0; i < n; ++i) s[i] &= x[i] <= v; break;
+    }
+}
+
+void db::select_column(const column_t &col, PredicateOp op, const field_t &value, std::vector<uint8_t> &sel) {
+    std::visit([&](const auto &values) {
+        using T = typename std::decay_t<decltype(values)>::value_type;
+        if (const T *v = std::get_if<T>(&value)) {
+            selectColumn(values, op, *v, sel);
+        } else {
+            // Fields of different types never compare true, as in compare().
+            std::fill(sel.begin(), sel.end(), 0);
+        }
+    }, col);
+}
@@ -38,11 +38,11 @@ struct Iterator {
     int operator*() const { return *reinterpret_cast<const int *>(data + slot * width); }
 };
 
-LeafPage::LeafPage(Page &page, const TupleDesc &td, size_t key_index) : td(td), key_index(key_index) {
+LeafPage::LeafPage(std::span<uint8_t> page, const TupleDesc &td, size_t key_index) : td(td), key_index(key_index) {
     // TODO pa2
     header = reinterpret_cast<LeafPageHeader *>(page.data());
-    capacity = (DEFAULT_PAGE_SIZE - sizeof(LeafPageHeader)) / td.length();
-    data = page.data() + DEFAULT_PAGE_SIZE - td.length() * capacity;
+    capacity = (page.size() - sizeof(LeafPageHeader)) / td.length();
+    data = page.data() + page.size() - td.length() * capacity;
 }
 
 bool LeafPage::insertTuple(const Tuple &t) {
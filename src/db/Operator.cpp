@@ -0,0 +1,464 @@
+#include <db/Accumulator.hpp>
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/HeapPage.hpp>
+#include <db/Kernels.hpp>
+#include <db/Operator.hpp>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+using namespace db;
+
+// Appends name to names, with a numeric suffix if it is already taken.
+static void addName(std::vector<std::string> &names, const std::string &name) {
+    std::string unique = name;
+    for (size_t i = 2; std::find(names.begin(), names.end(), unique) != names.end(); ++i) {
+        unique = name + std::to_string(i);
+    }
+    names.push_back(unique);
+}
+
+// The left fields followed by the right fields, without the right join field for equality joins.
+static TupleDesc joinedDesc(const TupleDesc &left, const TupleDesc &right, size_t ridx, PredicateOp op) {
+    std::vector<type_t> types;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < left.size(); ++i) {
+        types.push_back(left.type_of(i));
+        addName(names, left.name_of(i));
+    }
+    for (size_t i = 0; i < right.size(); ++i) {
+        if (op == PredicateOp::EQ && i == ridx) continue;
+        types.push_back(right.type_of(i));
+        addName(names, right.name_of(i));
+    }
+    return {types, names};
+}
+
+static void appendJoined(Batch &out, const Tuple &lt, const Tuple &rt, size_t ridx, PredicateOp op) {
+    std::vector<field_t> fields;
+    fields.reserve(lt.size() + rt.size());
+    for (size_t i = 0; i < lt.size(); ++i) fields.push_back(lt.get_field(i));
+    for (size_t i = 0; i < rt.size(); ++i) {
+        if (!(op == PredicateOp::EQ && i == ridx)) fields.push_back(rt.get_field(i));
+    }
+    out.append(Tuple(fields));
+}
+
+// Keeps the tuples of the batch that satisfy every predicate.
+static void applyPredicates(Batch &batch, const std::vector<FilterPredicate> &pred,
+                            const std::vector<size_t> &indices) {
+    if (pred.empty()) return;
+    std::vector<uint8_t> sel(batch.size(), 1);
+    for (size_t i = 0; i < pred.size(); ++i) {
+        select_column(batch.column(indices[i]), pred[i].op, pred[i].value, sel);
+    }
+    batch.select(sel);
+}
+
+ScanOperator::ScanOperator(const DbFile &file, std::vector<FilterPredicate> pred)
+        : file(file), pred(std::move(pred)) {
+    const TupleDesc &td = file.getTupleDesc();
+    // Without predicates readBatch already decodes a page at a time.
+    kernels = !this->pred.empty() && dynamic_cast<const HeapFile *>(&file) != nullptr;
+    for (const auto &p: this->pred) {
+        indices.push_back(td.index_of(p.field_name));
+        type_t type = td.type_of(indices.back());
+        if (!(type == type_t::INT && std::holds_alternative<int>(p.value)) &&
+            !(type == type_t::DOUBLE && std::holds_alternative<double>(p.value))) {
+            kernels = false;
+        }
+    }
+}
+
+const TupleDesc &ScanOperator::getTupleDesc() const { return file.getTupleDesc(); }
+
+void ScanOperator::open() {
+    it.emplace(file.begin());
+    page = 0;
+    slot = 0;
+}
+
+bool ScanOperator::next(Batch &batch) {
+    batch = Batch(file.getTupleDesc());
+    if (kernels) return nextPages(batch);
+    while (*it != file.end()) {
+        file.readBatch(*it, batch);
+        applyPredicates(batch, pred, indices);
+        if (batch.size() > 0) return true;
+    }
+    return false;
+}
+
+// Evaluates the predicates on the bytes of each page, starting from the occupancy bitmap, and decodes only the
+// selected slots. The mask of a page is kept when the batch fills up in the middle of it.
+bool ScanOperator::nextPages(Batch &batch) {
+    const TupleDesc &td = file.getTupleDesc();
+    while (batch.size() < BATCH_SIZE && page < file.getNumPages()) {
+        PageGuard guard = file.pinForRead(page);
+        const HeapPage hp(guard.page(), td);
+        if (slot == 0) {
+            mask.assign(hp.occupancy(), hp.occupancy() + (hp.end() + 7) / 8);
+            for (size_t i = 0; i < pred.size(); ++i) {
+                const uint8_t *base = hp.field(indices[i]);
+                if (const int *v = std::get_if<int>(&pred[i].value)) {
+                    select_int(base, td.length(), hp.end(), pred[i].op, *v, mask.data());
+                } else {
+                    select_double(base, td.length(), hp.end(), pred[i].op, std::get<double>(pred[i].value),
+                                  mask.data());
+                }
+            }
+        }
+        for (; slot < hp.end() && batch.size() < BATCH_SIZE; ++slot) {
+            if (mask[slot / 8] == 0) {
+                slot |= 7;
+                continue;
+            }
+            if (mask[slot / 8] & (1 << (7 - slot % 8))) hp.getTuple(slot, batch);
+        }
+        if (slot >= hp.end()) {
+            ++page;
+            slot = 0;
+        }
+    }
+    return batch.size() > 0;
+}
+
+void ScanOperator::close() {
+    it.reset();
+    mask.clear();
+}
+
+FilterOperator::FilterOperator(std::unique_ptr<Operator> child, std::vector<FilterPredicate> pred)
+        : child(std::move(child)), pred(std::move(pred)) {
+    for (const auto &p: this->pred) indices.push_back(this->child->getTupleDesc().index_of(p.field_name));
+}
+
+const TupleDesc &FilterOperator::getTupleDesc() const { return child->getTupleDesc(); }
+
+void FilterOperator::open() { child->open(); }
+
+bool FilterOperator::next(Batch &batch) {
+    while (child->next(batch)) {
+        applyPredicates(batch, pred, indices);
+        if (batch.size() > 0) return true;
+    }
+    return false;
+}
+
+void FilterOperator::close() { child->close(); }
+
+ProjectOperator::ProjectOperator(std::unique_ptr<Operator> child, const std::vector<std::string> &field_names)
+        : child(std::move(child)) {
+    const TupleDesc &in = this->child->getTupleDesc();
+    std::vector<type_t> types;
+    std::vector<std::string> names;
+    for (const auto &name: field_names) {
+        indices.push_back(in.index_of(name));
+        types.push_back(in.type_of(indices.back()));
+        addName(names, name);
+    }
+    td = TupleDesc(types, names);
+}
+
+const TupleDesc &ProjectOperator::getTupleDesc() const { return td; }
+
+void ProjectOperator::open() { child->open(); }
+
+bool ProjectOperator::next(Batch &batch) {
+    if (!child->next(batch)) return false;
+    batch.project(indices);
+    return true;
+}
+
+void ProjectOperator::close() { child->close(); }
+
+HashJoinOperator::HashJoinOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right,
+                                   const JoinPredicate &pred, bool buildLeft)
+        : left(std::move(left)), right(std::move(right)), buildLeft(buildLeft) {
+    if (pred.op != PredicateOp::EQ) {
+        throw std::logic_error("Hash join requires an equality predicate");
+    }
+    lidx = this->left->getTupleDesc().index_of(pred.left);
+    ridx = this->right->getTupleDesc().index_of(pred.right);
+    td = joinedDesc(this->left->getTupleDesc(), this->right->getTupleDesc(), ridx, pred.op);
+}
+
+const TupleDesc &HashJoinOperator::getTupleDesc() const { return td; }
+
+void HashJoinOperator::open() {
+    left->open();
+    right->open();
+    Operator &build = buildLeft ? *left : *right;
+    size_t bidx = buildLeft ? lidx : ridx;
+    Batch batch;
+    while (build.next(batch)) {
+        for (size_t r = 0; r < batch.size(); ++r) {
+            rows.push_back(batch.get_tuple(r));
+            table.emplace(rows.back().get_field(bidx), rows.size() - 1);
+        }
+    }
+    probe = Batch();
+    row = 0;
+    match = matchEnd = table.end();
+}
+
+bool HashJoinOperator::next(Batch &batch) {
+    batch = Batch(td);
+    Operator &probeSide = buildLeft ? *right : *left;
+    size_t pidx = buildLeft ? ridx : lidx;
+    while (batch.size() < BATCH_SIZE) {
+        if (match == matchEnd) {
+            if (row == probe.size()) {
+                row = 0;
+                if (!probeSide.next(probe)) break;
+            }
+            std::tie(match, matchEnd) = table.equal_range(probe.get_field(row++, pidx));
+            continue;
+        }
+        const Tuple pt = probe.get_tuple(row - 1);
+        const Tuple &bt = rows[match->second];
+        appendJoined(batch, buildLeft ? bt : pt, buildLeft ? pt : bt, ridx, PredicateOp::EQ);
+        ++match;
+    }
+    return batch.size() > 0;
+}
+
+void HashJoinOperator::close() {
+    left->close();
+    right->close();
+    table.clear();
+    rows.clear();
+    probe = Batch();
+}
+
+NestedLoopJoinOperator::NestedLoopJoinOperator(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right,
+                                               const JoinPredicate &pred)
+        : left(std::move(left)), right(std::move(right)), op(pred.op) {
+    lidx = this->left->getTupleDesc().index_of(pred.left);
+    ridx = this->right->getTupleDesc().index_of(pred.right);
+    td = joinedDesc(this->left->getTupleDesc(), this->right->getTupleDesc(), ridx, pred.op);
+}
+
+const TupleDesc &NestedLoopJoinOperator::getTupleDesc() const { return td; }
+
+void NestedLoopJoinOperator::open() {
+    left->open();
+    right->open();
+    Batch batch;
+    while (right->next(batch)) {
+        for (size_t r = 0; r < batch.size(); ++r) rows.push_back(batch.get_tuple(r));
+    }
+    probe = Batch();
+    row = 0;
+    pos = 0;
+}
+
+bool NestedLoopJoinOperator::next(Batch &batch) {
+    batch = Batch(td);
+    while (batch.size() < BATCH_SIZE) {
+        if (row == probe.size()) {
+            row = 0;
+            pos = 0;
+            if (!left->next(probe)) break;
+        }
+        const field_t lk = probe.get_field(row, lidx);
+        for (; pos < rows.size() && batch.size() < BATCH_SIZE; ++pos) {
+            if (compare(lk, rows[pos].get_field(ridx), op)) {
+                appendJoined(batch, probe.get_tuple(row), rows[pos], ridx, op);
+            }
+        }
+        if (pos == rows.size()) {
+            ++row;
+            pos = 0;
+        }
+    }
+    return batch.size() > 0;
+}
+
+void NestedLoopJoinOperator::close() {
+    left->close();
+    right->close();
+    rows.clear();
+    probe = Batch();
+}
+
+static std::string aggregateName(AggregateOp op) {
+    switch (op) {
+        case AggregateOp::SUM:
+            return "sum";
+        case AggregateOp::AVG:
+            return "avg";
+        case AggregateOp::MIN:
+            return "min";
+        case AggregateOp::MAX:
+            return "max";
+        case AggregateOp::COUNT:
+            return "count";
+    }
+    return "";
+}
+
+AggregateOperator::AggregateOperator(std::unique_ptr<Operator> child, const GroupBy &agg, size_t memory_pages,
+                                     size_t page_size)
+        : child(std::move(child)), depth(0) {
+    if (memory_pages == 0) {
+        throw std::invalid_argument("Memory budget must be at least one page");
+    }
+    if (agg.aggregates.empty()) {
+        throw std::logic_error("At least one aggregate is required");
+    }
+    const TupleDesc &in = this->child->getTupleDesc();
+    for (const auto &g: agg.groups) grpIdx.push_back(in.index_of(g));
+    for (const auto &a: agg.aggregates) aggs.emplace_back(a.op, in.index_of(a.field));
+    describe();
+
+    // An in-memory group costs about as much as the output tuple it produces.
+    maxGroups = std::max<size_t>(memory_pages * tuples_per_page(td, page_size), 1);
+    fanOut = std::max<size_t>(memory_pages - 1, 2);
+}
+
+AggregateOperator::AggregateOperator(std::unique_ptr<Operator> child, std::vector<size_t> grpIdx,
+                                     std::vector<std::pair<AggregateOp, size_t>> aggs, size_t maxGroups,
+                                     size_t fanOut, size_t depth)
+        : child(std::move(child)), grpIdx(std::move(grpIdx)), aggs(std::move(aggs)), maxGroups(maxGroups),
+          fanOut(fanOut), depth(depth) {
+    describe();
+}
+
+void AggregateOperator::describe() {
+    const TupleDesc &in = child->getTupleDesc();
+    std::vector<type_t> types;
+    std::vector<std::string> names;
+    for (size_t g: grpIdx) {
+        types.push_back(in.type_of(g));
+        addName(names, in.name_of(g));
+    }
+    for (const auto &[op, v]: aggs) {
+        switch (op) {
+            case AggregateOp::COUNT:
+                types.push_back(type_t::INT);
+                break;
+            case AggregateOp::AVG:
+                types.push_back(type_t::DOUBLE);
+                break;
+            default:
+                types.push_back(in.type_of(v));
+        }
+        addName(names, aggregateName(op) + "(" + in.name_of(v) + ")");
+    }
+    td = TupleDesc(types, names);
+}
+
+const TupleDesc &AggregateOperator::getTupleDesc() const { return td; }
+
+// Aggregates the whole input, spilling tuples of groups that do not fit in memory to hash partitions that next()
+// aggregates afterwards. Groups already in memory keep absorbing their tuples, so no group is split across outputs.
+void AggregateOperator::open() {
+    child->open();
+
+    // Groups are kept in the order they are first seen, with a hash index from key to group.
+    std::vector<std::pair<std::vector<field_t>, std::vector<Accumulator>>> groups;
+    std::unordered_map<std::vector<field_t>, size_t, KeyHash> index;
+    auto newGroup = [&](const std::vector<field_t> &key) {
+        std::vector<Accumulator> accs;
+        for (const auto &[op, v]: aggs) accs.emplace_back(op);
+        groups.emplace_back(key, std::move(accs));
+        return groups.size() - 1;
+    };
+
+    constexpr size_t SPILLED = SIZE_MAX;
+    Batch batch;
+    std::vector<size_t> gids;
+    std::vector<field_t> key;
+    while (child->next(batch)) {
+        if (grpIdx.empty()) {
+            // A single group consumes whole columns.
+            if (groups.empty()) newGroup(key);
+            auto &accs = groups[0].second;
+            for (size_t a = 0; a < aggs.size(); ++a) {
+                std::visit([&](const auto &values) { accs[a].addAll(values); }, batch.column(aggs[a].second));
+            }
+            continue;
+        }
+
+        // Resolve the group of every tuple first, then feed each aggregated column to the accumulators.
+        gids.resize(batch.size());
+        for (size_t row = 0; row < batch.size(); ++row) {
+            key.clear();
+            for (size_t g: grpIdx) key.push_back(batch.get_field(row, g));
+            auto pos = index.find(key);
+            if (pos != index.end()) {
+                gids[row] = pos->second;
+            } else if (groups.size() < maxGroups || depth == MAX_PARTITION_DEPTH) {
+                gids[row] = newGroup(key);
+                index.emplace(key, gids[row]);
+            } else {
+                // Spill only the group fields followed by the aggregated fields.
+                std::vector<field_t> fields(key);
+                for (const auto &[op, v]: aggs) fields.push_back(batch.get_field(row, v));
+                const Tuple t(fields);
+                if (spill.empty()) {
+                    std::vector<type_t> types;
+                    std::vector<std::string> names;
+                    for (size_t i = 0; i < t.size(); ++i) {
+                        types.push_back(t.field_type(i));
+                        names.push_back("f" + std::to_string(i));
+                    }
+                    TupleDesc partTd(types, names);
+                    for (size_t i = 0; i < fanOut; ++i) spill.emplace_back("aggregate", partTd);
+                }
+                spill[partition_of(KeyHash()(key), depth, fanOut)].file().insertTuple(t);
+                gids[row] = SPILLED;
+            }
+        }
+        for (size_t a = 0; a < aggs.size(); ++a) {
+            std::visit([&](const auto &values) {
+                for (size_t row = 0; row < values.size(); ++row) {
+                    if (gids[row] != SPILLED) groups[gids[row]].second[a].add(values[row]);
+                }
+            }, batch.column(aggs[a].second));
+        }
+    }
+
+    for (const auto &[k, accs]: groups) {
+        std::vector<field_t> fields(k);
+        for (const auto &acc: accs) fields.push_back(acc.result());
+        results.emplace_back(fields);
+    }
+    emitted = 0;
+    part = 0;
+}
+
+bool AggregateOperator::next(Batch &batch) {
+    if (emitted < results.size()) {
+        batch = Batch(td);
+        while (emitted < results.size() && batch.size() < BATCH_SIZE) batch.append(results[emitted++]);
+        return true;
+    }
+
+    // Spilled tuples are laid out as the group fields followed by one field per aggregate.
+    while (part < spill.size()) {
+        if (!partAgg) {
+            std::vector<size_t> partGrpIdx(grpIdx.size());
+            std::iota(partGrpIdx.begin(), partGrpIdx.end(), 0);
+            std::vector<std::pair<AggregateOp, size_t>> partAggs;
+            for (size_t a = 0; a < aggs.size(); ++a) partAggs.emplace_back(aggs[a].first, grpIdx.size() + a);
+            partAgg.reset(new AggregateOperator(std::make_unique<ScanOperator>(spill[part].file()), partGrpIdx,
+                                                partAggs, maxGroups, fanOut, depth + 1));
+            partAgg->open();
+        }
+        if (partAgg->next(batch)) return true;
+        partAgg->close();
+        partAgg.reset();
+        ++part;
+    }
+    return false;
+}
+
+void AggregateOperator::close() {
+    child->close();
+    partAgg.reset();
+    spill.clear();
+    results.clear();
+}
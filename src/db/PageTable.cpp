@@ -0,0 +1,58 @@
+#include <db/PageTable.hpp>
+#include <algorithm>
+#include <bit>
+
+using namespace db;
+
+PageTable::PageTable(size_t capacity) : entries(std::bit_ceil(std::max<size_t>(2, 2 * capacity))) {}
+
+size_t PageTable::home(const PageId &pid) const {
+    return std::hash<const PageId>()(pid) & (entries.size() - 1);
+}
+
+void PageTable::grow() {
+    std::vector<Entry> old(entries.size() * 2);
+    old.swap(entries);
+    count = 0;
+    for (const auto &entry: old) {
+        if (entry.slot != EMPTY) insert(entry.pid, entry.slot);
+    }
+}
+
+std::optional<size_t> PageTable::find(const PageId &pid) const {
+    size_t mask = entries.size() - 1;
+    for (size_t i = home(pid); entries[i].slot != EMPTY; i = (i + 1) & mask) {
+        if (entries[i].pid == pid) return entries[i].slot;
+    }
+    return std::nullopt;
+}
+
+void PageTable::insert(const PageId &pid, size_t slot) {
+    if (2 * (count + 1) > entries.size()) grow();
+    size_t mask = entries.size() - 1;
+    size_t i = home(pid);
+    while (entries[i].slot != EMPTY) i = (i + 1) & mask;
+    entries[i] = {pid, slot};
+    ++count;
+}
+
+bool PageTable::erase(const PageId &pid) {
+    size_t mask = entries.size() - 1;
+    size_t hole = home(pid);
+    while (entries[hole].slot != EMPTY && !(entries[hole].pid == pid)) hole = (hole + 1) & mask;
+    if (entries[hole].slot == EMPTY) return false;
+
+    // Move back every following entry of the run whose home is not between the hole and its position.
+    for (size_t i = (hole + 1) & mask; entries[i].slot != EMPTY; i = (i + 1) & mask) {
+        size_t h = home(entries[i].pid);
+        if (((i - h) & mask) >= ((i - hole) & mask)) {
+            entries[hole] = entries[i];
+            hole = i;
+        }
+    }
+    entries[hole] = {};
+    --count;
+    return true;
+}
+
+size_t PageTable::size() const { return count; }
@@ -1,5 +1,15 @@
+#include <db/Batch.hpp>
+#include <db/BTreeFile.hpp>
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/Operator.hpp>
 #include <db/Query.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <queue>
 #include <stdexcept>
+#include <unordered_map>
 
 using namespace db;
 
@@ -45,156 +55,343 @@ struct FieldVisitor {
 };
 
 // Common compare function
-static bool compare(const field_t &lhs, const field_t &rhs, PredicateOp op) {
+bool db::compare(const field_t &lhs, const field_t &rhs, PredicateOp op) {
     return std::visit(FieldVisitor{op, rhs}, lhs, rhs);
 }
 
-static double toDouble(const field_t &v) {
-    if (std::holds_alternative<int>(v)) return static_cast<double>(std::get<int>(v));
-    if (std::holds_alternative<double>(v)) return std::get<double>(v);
-    throw std::logic_error("Non-numeric field for numeric comparison");
-    return 0.0; // Unreachable, but keeps compiler happy
+// Runs an operator tree and inserts every tuple it produces into out.
+static void drain(Operator &op, DbFile &out) {
+    Batch batch;
+    op.open();
+    while (op.next(batch)) {
+        for (size_t row = 0; row < batch.size(); ++row) out.insertTuple(batch.get_tuple(row));
+    }
+    op.close();
 }
 
 void db::projection(const DbFile &in, DbFile &out, const std::vector<std::string> &field_names) {
     // TODO: Implement this function
-    const auto &td = in.getTupleDesc();
-    for (auto it = in.begin(); it != in.end(); in.next(it)) {
-        const Tuple t = in.getTuple(it);
-        std::vector<field_t> fields;
-        fields.reserve(field_names.size());
-        for (auto &name : field_names) {
-            fields.push_back(t.get_field(td.index_of(name)));
-        }
-        out.insertTuple(Tuple(fields));
-    }
+    ProjectOperator op(std::make_unique<ScanOperator>(in), field_names);
+    drain(op, out);
 }
 
 void db::filter(const DbFile &in, DbFile &out, const std::vector<FilterPredicate> &pred) {
     // TODO: Implement this function
-    const auto &td = in.getTupleDesc();
-    for (auto it = in.begin(); it != in.end(); in.next(it)) {
-        const Tuple t = in.getTuple(it);
-        bool keep = std::all_of(pred.begin(), pred.end(), [&](auto &p) {
-            return compare(t.get_field(td.index_of(p.field_name)), p.value, p.op);
-        });
-        if (keep) out.insertTuple(t);
-    }
+    ScanOperator op(in, pred);
+    drain(op, out);
 }
 
-void db::aggregate(const DbFile &in, DbFile &out, const Aggregate &agg) {
+void db::aggregate(const DbFile &in, DbFile &out, const GroupBy &agg, size_t memory_pages) {
+    AggregateOperator op(std::make_unique<ScanOperator>(in), agg, memory_pages, in.getPageSize());
+    drain(op, out);
+}
+
+void db::aggregate(const DbFile &in, DbFile &out, const Aggregate &agg, size_t memory_pages) {
     // TODO: Implement this function
-    const TupleDesc &td = in.getTupleDesc();
-    bool hasGroup = agg.group.has_value();
-    size_t grpIdx = hasGroup ? td.index_of(agg.group.value()) : 0;
-    size_t valIdx = td.index_of(agg.field);
+    GroupBy groupBy{{}, {{agg.op, agg.field}}};
+    if (agg.group.has_value()) groupBy.groups.push_back(agg.group.value());
+    aggregate(in, out, groupBy, memory_pages);
+}
+
+// Appends the concatenation of a matching left/right pair to out.
+// Equality joins drop the right join field since it duplicates the left one.
+static void emitJoined(DbFile &out, const Tuple &lt, const Tuple &rt, size_t ridx, PredicateOp op) {
+    std::vector<field_t> fields;
+    fields.reserve(lt.size() + rt.size() - (op == PredicateOp::EQ ? 1 : 0));
+    for (size_t i = 0; i < lt.size(); ++i) fields.push_back(lt.get_field(i));
+    for (size_t i = 0; i < rt.size(); ++i) {
+        if (!(op == PredicateOp::EQ && i == ridx)) fields.push_back(rt.get_field(i));
+    }
+    out.insertTuple(Tuple(fields));
+}
 
-    struct Group { field_t key; std::vector<field_t> vals; };
-    std::vector<Group> groups;
+void db::hash_join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred) {
+    // Build on the smaller input so the hash table stays small, probe with the larger one.
+    HashJoinOperator op(std::make_unique<ScanOperator>(left), std::make_unique<ScanOperator>(right), pred,
+                        left.getNumPages() < right.getNumPages());
+    drain(op, out);
+}
 
-    // Collect values per group
-    for (auto it = in.begin(); it != in.end(); in.next(it)) {
-        Tuple t = in.getTuple(it);
-        field_t key = hasGroup ? t.get_field(grpIdx) : field_t();
-        field_t val = t.get_field(valIdx);
-        if (!hasGroup) {
-            if (groups.empty()) groups.push_back({key, {}});
-            groups[0].vals.push_back(val);
-        } else {
-            bool found = false;
-            for (auto &g : groups) {
-                if (g.key == key) { g.vals.push_back(val); found = true; break; }
-            }
-            if (!found) groups.push_back({key, {val}});
+static void graceHashJoin(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred,
+                          size_t memory_pages, size_t depth) {
+    size_t buildPages = std::min(left.getNumPages(), right.getNumPages());
+    if (buildPages <= memory_pages || depth == MAX_PARTITION_DEPTH) {
+        hash_join(left, right, out, pred);
+        return;
+    }
+
+    // One output page per partition must fit in the budget while partitioning.
+    size_t n = std::clamp<size_t>((buildPages + memory_pages - 1) / memory_pages + 1, 2,
+                                  std::max<size_t>(memory_pages - 1, 2));
+
+    auto partition = [&](const DbFile &in, const std::string &field) {
+        std::vector<TempFile> parts;
+        parts.reserve(n);
+        for (size_t i = 0; i < n; ++i) parts.emplace_back("grace", in.getTupleDesc());
+        size_t idx = in.getTupleDesc().index_of(field);
+        for (auto it = in.begin(); it != in.end(); in.next(it)) {
+            const Tuple t = in.getTuple(it);
+            parts[partition_of(std::hash<field_t>()(t.get_field(idx)), depth, n)].file().insertTuple(t);
         }
+        return parts;
+    };
+    std::vector<TempFile> leftParts = partition(left, pred.left);
+    std::vector<TempFile> rightParts = partition(right, pred.right);
+
+    for (size_t i = 0; i < n; ++i) {
+        const DbFile &lp = leftParts[i].file();
+        const DbFile &rp = rightParts[i].file();
+        if (lp.begin() == lp.end() || rp.begin() == rp.end()) continue;
+        graceHashJoin(lp, rp, out, pred, memory_pages, depth + 1);
     }
+}
 
-    // Compute and emit
-    for (auto &g : groups) {
-        field_t result;
-        auto &vals = g.vals;
-        switch (agg.op) {
-            case AggregateOp::COUNT:
-                result = static_cast<int>(vals.size());
-                break;
-            case AggregateOp::SUM:
-                if (std::holds_alternative<int>(vals[0])) {
-                    int sum = 0;
-                    for (auto &v : vals) sum += std::get<int>(v);
-                    result = sum;
-                } else if (std::holds_alternative<double>(vals[0])) {
-                    double sum = 0;
-                    for (auto &v : vals) sum += std::get<double>(v);
-                    result = sum;
-                } else {
-                    throw std::logic_error("Cannot sum non-numeric field");
-                }
-                break;
-            case AggregateOp::AVG:
-                if (std::holds_alternative<int>(vals[0]) || std::holds_alternative<double>(vals[0])) {
-                    double sum = 0;
-                    for (auto &v : vals) sum += toDouble(v);
-                    result = sum / vals.size();
-                } else {
-                    throw std::logic_error("Cannot average non-numeric field");
-                }
-                break;
-            case AggregateOp::MIN:
-                if (std::holds_alternative<int>(vals[0])) {
-                    int m = std::get<int>(vals[0]);
-                    for (auto &v : vals) m = std::min(m, std::get<int>(v));
-                    result = m;
-                } else if (std::holds_alternative<double>(vals[0])) {
-                    double m = std::get<double>(vals[0]);
-                    for (auto &v : vals) m = std::min(m, std::get<double>(v));
-                    result = m;
-                } else {
-                    std::string m = std::get<std::string>(vals[0]);
-                    for (auto &v : vals) m = std::min(m, std::get<std::string>(v));
-                    result = m;
-                }
-                break;
-            case AggregateOp::MAX:
-                if (std::holds_alternative<int>(vals[0])) {
-                    int m = std::get<int>(vals[0]);
-                    for (auto &v : vals) m = std::max(m, std::get<int>(v));
-                    result = m;
-                } else if (std::holds_alternative<double>(vals[0])) {
-                    double m = std::get<double>(vals[0]);
-                    for (auto &v : vals) m = std::max(m, std::get<double>(v));
-                    result = m;
-                } else {
-                    std::string m = std::get<std::string>(vals[0]);
-                    for (auto &v : vals) m = std::max(m, std::get<std::string>(v));
-                    result = m;
+void db::grace_hash_join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred,
+                         size_t memory_pages) {
+    if (pred.op != PredicateOp::EQ) {
+        throw std::logic_error("Hash join requires an equality predicate");
+    }
+    if (memory_pages == 0) {
+        throw std::invalid_argument("Memory budget must be at least one page");
+    }
+    graceHashJoin(left, right, out, pred, memory_pages, 0);
+}
+
+// Returns true if iterating the file yields tuples in ascending order of field idx.
+static bool sortedOn(const DbFile &file, size_t idx) {
+    const auto *btree = dynamic_cast<const BTreeFile *>(&file);
+    return btree != nullptr && btree->getKeyIndex() == idx;
+}
+
+// Merges sorted runs into a single sorted file, at most fanIn runs at a time.
+static TempFile mergeRuns(std::vector<TempFile> runs, size_t idx, size_t fanIn) {
+    while (runs.size() > 1) {
+        std::vector<TempFile> merged;
+        for (size_t first = 0; first < runs.size(); first += fanIn) {
+            size_t last = std::min(first + fanIn, runs.size());
+            if (last - first == 1) {
+                merged.push_back(std::move(runs[first]));
+                continue;
+            }
+            const TupleDesc &td = runs[first].file().getTupleDesc();
+            TempFile dst("sort", td);
+            DbFile &out = dst.file();
+
+            struct Head {
+                field_t key;
+                size_t run;
+
+                bool operator>(const Head &other) const {
+                    return other.key < key || (key == other.key && run > other.run);
                 }
-                break;
+            };
+            std::vector<Iterator> its;
+            std::priority_queue<Head, std::vector<Head>, std::greater<>> heads;
+            for (size_t r = first; r < last; ++r) {
+                const DbFile &run = runs[r].file();
+                its.push_back(run.begin());
+                if (its.back() != run.end()) heads.push({run.getTuple(its.back()).get_field(idx), r - first});
+            }
+            while (!heads.empty()) {
+                size_t r = heads.top().run;
+                heads.pop();
+                const DbFile &run = runs[first + r].file();
+                out.insertTuple(run.getTuple(its[r]));
+                run.next(its[r]);
+                if (its[r] != run.end()) heads.push({run.getTuple(its[r]).get_field(idx), r});
+            }
+            merged.push_back(std::move(dst));
         }
-        std::vector<field_t> outFields;
-        if (hasGroup) outFields.push_back(g.key);
-        outFields.push_back(result);
-        out.insertTuple(Tuple(outFields));
+        runs = std::move(merged);
     }
+    return std::move(runs.front());
 }
 
-void db::join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred) {
-    // TODO: Implement this function
-    const auto &ld = left.getTupleDesc();
-    const auto &rd = right.getTupleDesc();
-    size_t lidx = ld.index_of(pred.left);
-    size_t ridx = rd.index_of(pred.right);
+// External merge sort of a file on field idx. Runs of memory_pages pages are sorted in memory, written to temporary
+// files and merged. The result is a temporary HeapFile whose iteration order is sorted.
+static TempFile externalSort(const DbFile &in, size_t idx, size_t memory_pages) {
+    const TupleDesc &td = in.getTupleDesc();
+    size_t runTuples = std::max<size_t>(memory_pages * tuples_per_page(td, in.getPageSize()), 1);
+    auto byKey = [idx](const Tuple &a, const Tuple &b) { return a.get_field(idx) < b.get_field(idx); };
+
+    std::vector<TempFile> runs;
+    std::vector<Tuple> buffer;
+    auto flush = [&]() {
+        std::stable_sort(buffer.begin(), buffer.end(), byKey);
+        TempFile run("sort", td);
+        for (const auto &t: buffer) run.file().insertTuple(t);
+        runs.push_back(std::move(run));
+        buffer.clear();
+    };
+    for (auto it = in.begin(); it != in.end(); in.next(it)) {
+        buffer.push_back(in.getTuple(it));
+        if (buffer.size() == runTuples) flush();
+    }
+    if (!buffer.empty() || runs.empty()) flush();
+    return mergeRuns(std::move(runs), idx, std::max<size_t>(memory_pages - 1, 2));
+}
+
+// Merges two inputs that iterate in ascending order of their join fields.
+static void mergeJoin(const DbFile &left, const DbFile &right, DbFile &out, size_t lidx, size_t ridx,
+                      PredicateOp op) {
+    auto rit = right.begin();
+    if (op == PredicateOp::EQ) {
+        auto lit = left.begin();
+        while (lit != left.end() && rit != right.end()) {
+            Tuple lt = left.getTuple(lit);
+            const field_t lk = lt.get_field(lidx);
+            const field_t rk = right.getTuple(rit).get_field(ridx);
+            if (lk < rk) {
+                left.next(lit);
+                continue;
+            }
+            if (rk < lk) {
+                right.next(rit);
+                continue;
+            }
+            // Join the group of equal keys on both sides, rescanning the right group for each left tuple.
+            Iterator groupEnd = rit;
+            while (true) {
+                Iterator r = rit;
+                for (; r != right.end(); right.next(r)) {
+                    const Tuple rt = right.getTuple(r);
+                    if (rt.get_field(ridx) != lk) break;
+                    emitJoined(out, lt, rt, ridx, op);
+                }
+                groupEnd.page = r.page;
+                groupEnd.slot = r.slot;
+                left.next(lit);
+                if (lit == left.end()) break;
+                lt = left.getTuple(lit);
+                if (lt.get_field(lidx) != lk) break;
+            }
+            rit.page = groupEnd.page;
+            rit.slot = groupEnd.slot;
+        }
+        return;
+    }
+
+    // For a range predicate the matches of each left tuple are a suffix (LT, LE) or a prefix (GT, GE) of the
+    // right input. The boundary only moves forward as the left key increases.
+    bool suffix = op == PredicateOp::LT || op == PredicateOp::LE;
     for (auto lit = left.begin(); lit != left.end(); left.next(lit)) {
         const Tuple lt = left.getTuple(lit);
+        const field_t &lk = lt.get_field(lidx);
+        while (rit != right.end()) {
+            const field_t rk = right.getTuple(rit).get_field(ridx);
+            bool pastBoundary = suffix ? compare(lk, rk, op) : !compare(lk, rk, op);
+            if (pastBoundary) break;
+            right.next(rit);
+        }
+        auto r = suffix ? Iterator(rit) : right.begin();
+        auto last = suffix ? right.end() : Iterator(rit);
+        for (; r != last; right.next(r)) {
+            emitJoined(out, lt, right.getTuple(r), ridx, op);
+        }
+    }
+}
+
+void db::sort_merge_join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred,
+                         size_t memory_pages) {
+    if (pred.op == PredicateOp::NE) {
+        throw std::logic_error("Sort-merge join does not support NE predicates");
+    }
+    if (memory_pages == 0) {
+        throw std::invalid_argument("Memory budget must be at least one page");
+    }
+    size_t lidx = left.getTupleDesc().index_of(pred.left);
+    size_t ridx = right.getTupleDesc().index_of(pred.right);
+
+    // Inputs that are already ordered on the join field are merged directly, the others are sorted first.
+    std::optional<TempFile> lsorted, rsorted;
+    if (!sortedOn(left, lidx)) lsorted.emplace(externalSort(left, lidx, memory_pages));
+    if (!sortedOn(right, ridx)) rsorted.emplace(externalSort(right, ridx, memory_pages));
+    mergeJoin(lsorted ? lsorted->file() : left, rsorted ? rsorted->file() : right, out, lidx, ridx, pred.op);
+}
+
+void db::block_nested_loop_join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred,
+                                size_t block_pages) {
+    if (block_pages == 0) {
+        throw std::invalid_argument("Block size must be at least one page");
+    }
+    size_t lidx = left.getTupleDesc().index_of(pred.left);
+    size_t ridx = right.getTupleDesc().index_of(pred.right);
+
+    std::vector<Tuple> block;
+    auto lit = left.begin();
+    while (lit != left.end()) {
+        // Load the tuples of the next block_pages left pages.
+        block.clear();
+        size_t pages = 1;
+        size_t page = lit.page;
+        for (; lit != left.end(); left.next(lit)) {
+            if (lit.page != page) {
+                if (pages == block_pages) break;
+                page = lit.page;
+                ++pages;
+            }
+            block.push_back(left.getTuple(lit));
+        }
+
+        // One pass over the right input per block instead of per left tuple.
         for (auto rit = right.begin(); rit != right.end(); right.next(rit)) {
             const Tuple rt = right.getTuple(rit);
-            if (!compare(lt.get_field(lidx), rt.get_field(ridx), pred.op)) continue;
-            std::vector<field_t> fields;
-            fields.reserve(ld.size() + rd.size() - (pred.op == PredicateOp::EQ ? 1 : 0));
-            for (size_t i = 0; i < ld.size(); ++i) fields.push_back(lt.get_field(i));
-            for (size_t i = 0; i < rd.size(); ++i) {
-                if (!(pred.op == PredicateOp::EQ && i == ridx)) fields.push_back(rt.get_field(i));
+            const field_t &rk = rt.get_field(ridx);
+            for (const auto &lt: block) {
+                if (compare(lt.get_field(lidx), rk, pred.op)) emitJoined(out, lt, rt, ridx, pred.op);
             }
-            out.insertTuple(Tuple(fields));
         }
     }
 }
+
+void db::index_nested_loop_join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred) {
+    size_t lidx = left.getTupleDesc().index_of(pred.left);
+    size_t ridx = right.getTupleDesc().index_of(pred.right);
+    if (!sortedOn(right, ridx)) {
+        throw std::logic_error("Index nested-loop join requires a BTreeFile keyed on the right join field");
+    }
+    if (pred.op == PredicateOp::NE) {
+        throw std::logic_error("Index nested-loop join does not support NE predicates");
+    }
+    const auto &index = dynamic_cast<const BTreeFile &>(right);
+
+    for (auto lit = left.begin(); lit != left.end(); left.next(lit)) {
+        const Tuple lt = left.getTuple(lit);
+        const field_t &lk = lt.get_field(lidx);
+        if (!std::holds_alternative<int>(lk)) {
+            throw std::logic_error("Index nested-loop join requires an INT left join field");
+        }
+        // EQ, LT and LE matches start at the first key not less than lk, GT and GE matches start at the first key.
+        bool fromKey = pred.op == PredicateOp::EQ || pred.op == PredicateOp::LT || pred.op == PredicateOp::LE;
+        auto rit = fromKey ? index.seek(std::get<int>(lk)) : index.begin();
+        for (; rit != index.end(); index.next(rit)) {
+            const Tuple rt = index.getTuple(rit);
+            if (compare(lk, rt.get_field(ridx), pred.op)) {
+                emitJoined(out, lt, rt, ridx, pred.op);
+            } else if (pred.op != PredicateOp::LT) {
+                // Only LT can skip keys (those equal to lk) before its matches start.
+                break;
+            }
+        }
+    }
+}
+
+void db::join(const DbFile &left, const DbFile &right, DbFile &out, const JoinPredicate &pred,
+              size_t memory_pages) {
+    // TODO: Implement this function
+    size_t lidx = left.getTupleDesc().index_of(pred.left);
+    size_t ridx = right.getTupleDesc().index_of(pred.right);
+    bool ordered = sortedOn(left, lidx) && sortedOn(right, ridx);
+    // Probing the index costs about one leaf read per left tuple, scanning it costs every page.
+    bool selective =
+            left.getNumPages() * tuples_per_page(left.getTupleDesc(), left.getPageSize()) < right.getNumPages();
+    if (pred.op == PredicateOp::EQ && !ordered && sortedOn(right, ridx) && selective) {
+        index_nested_loop_join(left, right, out, pred);
+    } else if (pred.op == PredicateOp::EQ && !ordered) {
+        grace_hash_join(left, right, out, pred, memory_pages);
+    } else if (pred.op != PredicateOp::NE) {
+        sort_merge_join(left, right, out, pred, memory_pages);
+    } else {
+        block_nested_loop_join(left, right, out, pred, memory_pages);
+    }
+}
@@ -0,0 +1,215 @@
+#include <db/ReplacementPolicy.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace db;
+
+SlotList::SlotList(size_t slots) : prev(slots + 1, slots), next(slots + 1, slots), linked(slots) {}
+
+void SlotList::push_front(size_t slot) {
+    size_t head = linked.size();
+    prev[slot] = head;
+    next[slot] = next[head];
+    prev[next[head]] = slot;
+    next[head] = slot;
+    linked[slot] = true;
+    ++count;
+}
+
+void SlotList::erase(size_t slot) {
+    next[prev[slot]] = next[slot];
+    prev[next[slot]] = prev[slot];
+    linked[slot] = false;
+    --count;
+}
+
+bool SlotList::contains(size_t slot) const { return linked[slot]; }
+
+size_t SlotList::size() const { return count; }
+
+std::optional<size_t> SlotList::find_back(const std::function<bool(size_t)> &pred) const {
+    for (size_t slot = prev[linked.size()]; slot != linked.size(); slot = prev[slot]) {
+        if (pred(slot)) return slot;
+    }
+    return std::nullopt;
+}
+
+LRUPolicy::LRUPolicy(size_t slots) : list(slots) {}
+
+void LRUPolicy::insert(size_t slot, const PageId &) {
+    std::lock_guard lock(mutex);
+    if (list.contains(slot)) list.erase(slot);
+    list.push_front(slot);
+}
+
+void LRUPolicy::access(size_t slot) {
+    std::lock_guard lock(mutex);
+    if (!list.contains(slot)) return;
+    list.erase(slot);
+    list.push_front(slot);
+}
+
+bool LRUPolicy::remove(size_t slot) {
+    std::lock_guard lock(mutex);
+    if (!list.contains(slot)) return false;
+    list.erase(slot);
+    return true;
+}
+
+std::optional<size_t> LRUPolicy::evict(const std::function<bool(size_t)> &evictable) {
+    std::lock_guard lock(mutex);
+    std::optional<size_t> slot = list.find_back(evictable);
+    if (slot) list.erase(*slot);
+    return slot;
+}
+
+// The page was used while it was being evicted: it is the most recently used one again.
+void LRUPolicy::restore(size_t slot) {
+    std::lock_guard lock(mutex);
+    if (!list.contains(slot)) list.push_front(slot);
+}
+
+ClockPolicy::ClockPolicy(size_t slots) : referenced(slots), tracked(slots) {}
+
+void ClockPolicy::insert(size_t slot, const PageId &) {
+    std::lock_guard lock(mutex);
+    tracked[slot] = true;
+    referenced[slot].store(true, std::memory_order_relaxed);
+}
+
+void ClockPolicy::access(size_t slot) {
+    // Only read by the hand; a bit set on a slot that is not tracked is overwritten when it is inserted again.
+    referenced[slot].store(true, std::memory_order_relaxed);
+}
+
+bool ClockPolicy::remove(size_t slot) {
+    std::lock_guard lock(mutex);
+    bool was = tracked[slot];
+    tracked[slot] = false;
+    return was;
+}
+
+std::optional<size_t> ClockPolicy::evict(const std::function<bool(size_t)> &evictable) {
+    std::lock_guard lock(mutex);
+    // Sweep until a slot is found unreferenced, or a whole pass finds no evictable slot.
+    while (true) {
+        bool candidates = false;
+        for (size_t step = 0; step < tracked.size(); ++step) {
+            size_t slot = hand;
+            hand = (hand + 1) % tracked.size();
+            if (!tracked[slot] || !evictable(slot)) continue;
+            candidates = true;
+            if (referenced[slot].exchange(false, std::memory_order_relaxed)) continue;
+            tracked[slot] = false;
+            return slot;
+        }
+        if (!candidates) return std::nullopt;
+    }
+}
+
+// An access while the page was being evicted already set its reference bit.
+void ClockPolicy::restore(size_t slot) {
+    std::lock_guard lock(mutex);
+    tracked[slot] = true;
+}
+
+TwoQueuePolicy::TwoQueuePolicy(size_t slots)
+        : a1in(slots), am(slots), pages(slots), evicted_from_am(slots), kin(std::max<size_t>(1, slots / 4)), kout(slots / 2) {}
+
+// Stops tracking a slot, whichever queue it is in.
+void TwoQueuePolicy::forget(size_t slot) {
+    if (a1in.contains(slot)) a1in.erase(slot);
+    if (am.contains(slot)) am.erase(slot);
+}
+
+void TwoQueuePolicy::insert(size_t slot, const PageId &pid) {
+    std::lock_guard lock(mutex);
+    forget(slot);
+    pages[slot] = pid;
+    auto it = ghosts.find(pid);
+    if (it == ghosts.end()) {
+        a1in.push_front(slot);
+        return;
+    }
+    a1out.erase(it->second);
+    ghosts.erase(it);
+    am.push_front(slot);
+}
+
+void TwoQueuePolicy::access(size_t slot) {
+    std::lock_guard lock(mutex);
+    // Accesses to pages in A1in are correlated references of a first read and do not count.
+    if (!am.contains(slot)) return;
+    am.erase(slot);
+    am.push_front(slot);
+}
+
+bool TwoQueuePolicy::remove(size_t slot) {
+    std::lock_guard lock(mutex);
+    if (!a1in.contains(slot) && !am.contains(slot)) return false;
+    forget(slot);
+    return true;
+}
+
+std::optional<size_t> TwoQueuePolicy::evict(const std::function<bool(size_t)> &evictable) {
+    std::lock_guard lock(mutex);
+    std::optional<size_t> slot;
+    if (a1in.size() > kin) slot = a1in.find_back(evictable);
+    if (!slot) slot = am.find_back(evictable);
+    if (!slot) slot = a1in.find_back(evictable);
+    if (!slot) return std::nullopt;
+
+    if (a1in.contains(*slot) && kout > 0) {
+        if (a1out.size() == kout) {
+            ghosts.erase(a1out.back());
+            a1out.pop_back();
+        }
+        a1out.push_front(pages[*slot]);
+        ghosts[pages[*slot]] = a1out.begin();
+    }
+    evicted_from_am[*slot] = am.contains(*slot);
+    forget(*slot);
+    return slot;
+}
+
+// The slot goes back to the queue it was evicted from. A page of A1in loses the ghost evict() gave it, so that it is
+// not taken for a page read again and promoted to Am.
+void TwoQueuePolicy::restore(size_t slot) {
+    std::lock_guard lock(mutex);
+    if (a1in.contains(slot) || am.contains(slot)) return;
+    if (evicted_from_am[slot]) {
+        am.push_front(slot);
+        return;
+    }
+    auto it = ghosts.find(pages[slot]);
+    if (it != ghosts.end()) {
+        a1out.erase(it->second);
+        ghosts.erase(it);
+    }
+    a1in.push_front(slot);
+}
+
+// The ghosts of the file would otherwise promote the first pages read of the next file given its id straight to Am.
+void TwoQueuePolicy::forgetFile(uint32_t file) {
+    std::lock_guard lock(mutex);
+    for (auto it = a1out.begin(); it != a1out.end();) {
+        if (it->file == file) {
+            ghosts.erase(*it);
+            it = a1out.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::unique_ptr<ReplacementPolicy> db::make_policy(Replacement replacement, size_t slots) {
+    switch (replacement) {
+        case Replacement::LRU:
+            return std::make_unique<LRUPolicy>(slots);
+        case Replacement::CLOCK:
+            return std::make_unique<ClockPolicy>(slots);
+        case Replacement::TWO_Q:
+            return std::make_unique<TwoQueuePolicy>(slots);
+    }
+    throw std::invalid_argument("Unknown replacement policy");
+}
@@ -0,0 +1,39 @@
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/TempFile.hpp>
+#include <cstdio>
+
+using namespace db;
+
+TempFile::TempFile(const std::string &tag, const TupleDesc &td) {
+    static size_t counter = 0;
+    name = tag + "." + std::to_string(counter++) + ".tmp";
+    std::remove(name.c_str());
+    getDatabase().add(std::make_unique<HeapFile>(name, td));
+}
+
+TempFile::~TempFile() {
+    if (name.empty()) return;
+    getDatabase().getBufferPool().discardFile(name);
+    getDatabase().remove(name);
+    std::remove(name.c_str());
+    std::remove((name + FREE_SPACE_MAP_SUFFIX).c_str());
+}
+
+TempFile::TempFile(TempFile &&other) noexcept : name(std::move(other.name)) { other.name.clear(); }
+
+DbFile &TempFile::file() const { return getDatabase().get(name); }
+
+size_t db::partition_of(size_t hash, size_t seed, size_t n) {
+    uint64_t h = hash ^ (seed * 0x9e3779b97f4a7c15ULL);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h % n;
+}
+
+size_t db::tuples_per_page(const TupleDesc &td, size_t page_size) {
+    return page_size * 8 / (td.length() * 8 + 1);
+}
@@ -25,7 +25,8 @@ size_t Tuple::size() const { return fields.size(); }
 
 const field_t &Tuple::get_field(size_t i) const { return fields.at(i); }
 
-TupleDesc::TupleDesc(const std::vector<type_t> &types, const std::vector<std::string> &names) : types(types) {
+TupleDesc::TupleDesc(const std::vector<type_t> &types, const std::vector<std::string> &names)
+        : types(types), names(names) {
     // TODO pa1
     if (types.size() != names.size()) {
         throw std::logic_error("Types and names sizes do not match");
@@ -77,6 +78,10 @@ size_t TupleDesc::offset_of(const size_t &index) const {
     return offsets.at(index);
 }
 
+type_t TupleDesc::type_of(size_t index) const { return types.at(index); }
+
+const std::string &TupleDesc::name_of(size_t index) const { return names.at(index); }
+
 // Returns the total length (in bytes) required to store a tuple.
 size_t TupleDesc::length() const {
     // TODO pa1
@@ -2,6 +2,7 @@
 #include <db/HeapFile.hpp>
 #include <db/Query.hpp>
 #include <gtest/gtest.h>
+#include <map>
 #include <random>
 
 TEST(AggregateTest, Min) {
@@ -270,3 +271,142 @@ TEST(AggregateTest, Grouped) {
     ++it;
     EXPECT_EQ(it, out.end());
 }
+
+TEST(AggregateTest, GroupedManyKeys) {
+    std::vector<db::type_t> types1{db::type_t::INT, db::type_t::INT, db::type_t::DOUBLE};
+    std::vector<std::string> names1{"id", "key", "price"};
+    db::TupleDesc td1(types1, names1);
+
+    std::vector<db::type_t> types2{db::type_t::INT, db::type_t::INT};
+    std::vector<std::string> names2{"key", "result"};
+    db::TupleDesc td2(types2, names2);
+
+    const char *in_name = "heapfile.in";
+    const char *out_name = "heapfile.out";
+    std::remove(in_name);
+    std::remove(out_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(in_name, td1));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(out_name, td2));
+    auto &in = db::getDatabase().get(in_name);
+    auto &out = db::getDatabase().get(out_name);
+
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<> dis(-100000, 100000);
+    std::unordered_map<int, int> expected;
+    for (int i = 0; i < 20000; ++i) {
+        int v = dis(gen);
+        int key = i % 5000;
+        expected[key] = std::max(expected.count(key) ? expected[key] : v, v);
+        in.insertTuple({{v, key, 3.14}});
+    }
+
+    db::aggregate(in, out, {"key", db::AggregateOp::MAX, "id"});
+    size_t groups = 0;
+    for (const auto &t: out) {
+        EXPECT_EQ(std::get<int>(t.get_field(1)), expected.at(std::get<int>(t.get_field(0))));
+        ++groups;
+    }
+    EXPECT_EQ(groups, expected.size());
+}
+
+TEST(AggregateTest, GroupedSpill) {
+    std::vector<db::type_t> types1{db::type_t::INT, db::type_t::INT, db::type_t::DOUBLE};
+    std::vector<std::string> names1{"id", "key", "price"};
+    db::TupleDesc td1(types1, names1);
+
+    std::vector<db::type_t> types2{db::type_t::INT, db::type_t::DOUBLE};
+    std::vector<std::string> names2{"key", "result"};
+    db::TupleDesc td2(types2, names2);
+
+    const char *in_name = "heapfile.in";
+    const char *mem_name = "memory.out";
+    const char *spill_name = "spill.out";
+    std::remove(in_name);
+    std::remove(mem_name);
+    std::remove(spill_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(in_name, td1));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(mem_name, td2));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(spill_name, td2));
+    auto &in = db::getDatabase().get(in_name);
+    auto &mem = db::getDatabase().get(mem_name);
+    auto &spill = db::getDatabase().get(spill_name);
+
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<> dis(-100000, 100000);
+    for (int i = 0; i < 20000; ++i) {
+        in.insertTuple({{dis(gen), i % 5000, 3.14}});
+    }
+
+    // A single page holds about 300 groups, so most of the 5000 groups are spilled to disk.
+    db::aggregate(in, mem, {"key", db::AggregateOp::AVG, "id"});
+    db::aggregate(in, spill, {"key", db::AggregateOp::AVG, "id"}, 1);
+
+    std::map<int, double> expected;
+    for (const auto &t: mem) {
+        expected[std::get<int>(t.get_field(0))] = std::get<double>(t.get_field(1));
+    }
+    std::map<int, double> actual;
+    for (const auto &t: spill) {
+        EXPECT_TRUE(actual.emplace(std::get<int>(t.get_field(0)), std::get<double>(t.get_field(1))).second);
+    }
+    EXPECT_EQ(expected.size(), 5000);
+    EXPECT_EQ(actual, expected);
+}
+
+TEST(AggregateTest, MultipleKeysAndAggregates) {
+    std::vector<db::type_t> types1{db::type_t::INT, db::type_t::CHAR, db::type_t::INT, db::type_t::DOUBLE};
+    std::vector<std::string> names1{"id", "name", "bucket", "price"};
+    db::TupleDesc td1(types1, names1);
+
+    std::vector<db::type_t> types2{db::type_t::CHAR, db::type_t::INT, db::type_t::INT, db::type_t::INT,
+                                   db::type_t::DOUBLE};
+    std::vector<std::string> names2{"name", "bucket", "sum", "count", "max"};
+    db::TupleDesc td2(types2, names2);
+
+    const char *in_name = "heapfile.in";
+    const char *out_name = "heapfile.out";
+    std::remove(in_name);
+    std::remove(out_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(in_name, td1));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(out_name, td2));
+    auto &in = db::getDatabase().get(in_name);
+    auto &out = db::getDatabase().get(out_name);
+
+    struct Expected {
+        int sum = 0;
+        int count = 0;
+        double max = 0;
+    };
+    std::map<std::pair<std::string, int>, Expected> expected;
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<> dis(-100000, 100000);
+    for (int i = 0; i < 5000; ++i) {
+        int v = dis(gen);
+        std::string name = v % 2 == 0 ? "even" : "odd";
+        int bucket = i % 7;
+        double price = (i % 101) * 0.5;
+        auto &e = expected[{name, bucket}];
+        e.sum += v;
+        e.max = e.count == 0 ? price : std::max(e.max, price);
+        ++e.count;
+        in.insertTuple({{v, name, bucket, price}});
+    }
+
+    size_t before = in.getReads().size();
+    db::aggregate(in, out, db::GroupBy{{"name", "bucket"},
+                                       {{db::AggregateOp::SUM, "id"},
+                                        {db::AggregateOp::COUNT, "id"},
+                                        {db::AggregateOp::MAX, "price"}}});
+    // One scan of the input computes all three aggregates.
+    EXPECT_LE(in.getReads().size() - before, in.getNumPages());
+
+    size_t groups = 0;
+    for (const auto &t: out) {
+        const auto &e = expected.at({std::get<std::string>(t.get_field(0)), std::get<int>(t.get_field(1))});
+        EXPECT_EQ(std::get<int>(t.get_field(2)), e.sum);
+        EXPECT_EQ(std::get<int>(t.get_field(3)), e.count);
+        EXPECT_EQ(std::get<double>(t.get_field(4)), e.max);
+        ++groups;
+    }
+    EXPECT_EQ(groups, expected.size());
+}
@@ -0,0 +1,30 @@
+#include <db/BTreeFile.hpp>
+#include <db/Database.hpp>
+#include <gtest/gtest.h>
+
+TEST(BTreeTest, Seek) {
+    const char *name = "seek.db";
+    std::remove(name);
+    db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE}, {"id", "name", "price"});
+    db::getDatabase().add(std::make_unique<db::BTreeFile>(name, td, 0));
+    auto &file = dynamic_cast<db::BTreeFile &>(db::getDatabase().get(name));
+    EXPECT_EQ(file.seek(0), file.end());
+    for (int i = 0; i < 100000; i++) {
+        int k = i % 2 ? 100000 - i : i;
+        db::Tuple t{{k * 2, "apple", 1.0}};
+        file.insertTuple(t);
+    }
+    for (int k = -1; k < 200000; k += 997) {
+        auto it = file.seek(k);
+        ASSERT_NE(it, file.end());
+        int expected = k < 0 ? 0 : (k + 1) / 2 * 2;
+        EXPECT_EQ(std::get<int>((*it).get_field(0)), expected);
+        ++it;
+        if (it != file.end()) {
+            EXPECT_EQ(std::get<int>((*it).get_field(0)), expected + 2);
+        }
+    }
+    EXPECT_EQ(file.seek(200000), file.end());
+    db::getDatabase().remove(name);
+    std::remove(name);
+}
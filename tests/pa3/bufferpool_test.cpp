@@ -0,0 +1,698 @@
+#include <algorithm>
+#include <cstring>
+#include <db/BTreeFile.hpp>
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/HeapPage.hpp>
+#include <db/IoQueue.hpp>
+#include <db/PageTable.hpp>
+#include <db/TempFile.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+
+TEST(BufferPoolTest, Pinning) {
+    db::Database &db = db::getDatabase();
+    db::BufferPool &bufferPool = db.getBufferPool();
+    std::remove("pinned");
+    db.add(std::make_unique<db::DbFile>("pinned", db::TupleDesc()));
+
+    {
+        db::PageGuard guard = bufferPool.pin({"pinned", 0}, db::Latch::EXCLUSIVE);
+        guard.page()[0] = 42;
+        guard.markDirty();
+        for (size_t i = 1; i <= 2 * db::DEFAULT_NUM_PAGES; ++i) {
+            bufferPool.getPage({"pinned", i});
+        }
+        EXPECT_TRUE(bufferPool.contains({"pinned", 0}));
+        EXPECT_THROW(bufferPool.discardPage({"pinned", 0}), std::logic_error);
+    }
+    EXPECT_TRUE(bufferPool.isDirty({"pinned", 0}));
+
+    std::vector<db::PageGuard> guards;
+    for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; ++i) {
+        guards.push_back(bufferPool.pin({"pinned", i}));
+    }
+    EXPECT_THROW(bufferPool.getPage({"pinned", db::DEFAULT_NUM_PAGES}), std::runtime_error);
+    EXPECT_EQ(guards[0].page()[0], 42);
+    guards.clear();
+
+    // Evict page 0, which must be written back and read again.
+    for (size_t i = 1; i <= db::DEFAULT_NUM_PAGES; ++i) {
+        bufferPool.getPage({"pinned", i});
+    }
+    EXPECT_FALSE(bufferPool.contains({"pinned", 0}));
+    EXPECT_EQ(bufferPool.pin({"pinned", 0}).page()[0], 42);
+}
+
+TEST(BufferPoolTest, ConcurrentAccess) {
+    db::Database &db = db::getDatabase();
+    db::BufferPool &bufferPool = db.getBufferPool();
+    std::remove("counters");
+    std::remove("heapfile.in");
+    db.add(std::make_unique<db::DbFile>("counters", db::TupleDesc()));
+    db::TupleDesc td({db::type_t::INT, db::type_t::DOUBLE}, {"id", "value"});
+    db.add(std::make_unique<db::HeapFile>("heapfile.in", td));
+    auto &in = db.get("heapfile.in");
+    for (int i = 0; i < 20000; ++i) {
+        in.insertTuple({{i, i * 0.5}});
+    }
+    ASSERT_GT(in.getNumPages(), db::DEFAULT_NUM_PAGES);
+
+    // Readers scan a file larger than the pool while writers increment counters in pages they latch exclusively.
+    constexpr size_t threads = 8;
+    constexpr int increments = 500;
+    std::vector<long> sums(threads);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            if (t % 2 == 0) {
+                for (auto it = in.begin(); it != in.end(); in.next(it)) {
+                    sums[t] += std::get<int>(in.getTuple(it).get_field(0));
+                }
+                return;
+            }
+            for (int i = 0; i < increments; ++i) {
+                db::PageGuard guard = bufferPool.pin({"counters", static_cast<size_t>(i % 4)}, db::Latch::EXCLUSIVE);
+                int count;
+                std::memcpy(&count, guard.page().data(), sizeof(count));
+                ++count;
+                std::memcpy(guard.page().data(), &count, sizeof(count));
+                guard.markDirty();
+            }
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+
+    for (size_t t = 0; t < threads; t += 2) {
+        EXPECT_EQ(sums[t], 20000L * 19999 / 2);
+    }
+    int total = 0;
+    for (size_t page = 0; page < 4; ++page) {
+        int count;
+        std::memcpy(&count, bufferPool.pin({"counters", page}).page().data(), sizeof(count));
+        total += count;
+    }
+    EXPECT_EQ(total, threads / 2 * increments);
+}
+
+TEST(BufferPoolTest, Clock) {
+    db::Database &db = db::getDatabase();
+    std::remove("clock");
+    db.add(std::make_unique<db::DbFile>("clock", db::TupleDesc()));
+    auto bufferPool = std::make_unique<db::BufferPool>(db::BufferPoolOptions{.replacement = db::Replacement::CLOCK});
+
+    for (size_t i = 0; i < db::DEFAULT_NUM_PAGES; ++i) {
+        bufferPool->getPage({"clock", i});
+    }
+    // Every page is referenced: the hand clears them all and comes back to the first one.
+    bufferPool->getPage({"clock", db::DEFAULT_NUM_PAGES});
+    EXPECT_FALSE(bufferPool->contains({"clock", 0}));
+    bufferPool->getPage({"clock", 2});
+    bufferPool->getPage({"clock", db::DEFAULT_NUM_PAGES + 1});
+    EXPECT_FALSE(bufferPool->contains({"clock", 1}));
+    // Page 2 gets a second chance.
+    bufferPool->getPage({"clock", db::DEFAULT_NUM_PAGES + 2});
+    EXPECT_TRUE(bufferPool->contains({"clock", 2}));
+    EXPECT_FALSE(bufferPool->contains({"clock", 3}));
+
+    // Pinned pages are skipped.
+    db::PageGuard guard = bufferPool->pin({"clock", 4});
+    bufferPool->getPage({"clock", db::DEFAULT_NUM_PAGES + 3});
+    EXPECT_TRUE(bufferPool->contains({"clock", 4}));
+    EXPECT_FALSE(bufferPool->contains({"clock", 5}));
+}
+
+TEST(BufferPoolTest, ScanResistance) {
+    db::Database &db = db::getDatabase();
+    for (const char *name: {"index", "table"}) {
+        std::remove(name);
+        db.add(std::make_unique<db::DbFile>(name, db::TupleDesc()));
+    }
+
+    // Each round reads a few index pages, then scans more table pages than the pool holds.
+    auto hits = [](db::Replacement replacement) {
+        auto bufferPool = std::make_unique<db::BufferPool>(db::BufferPoolOptions{.replacement = replacement});
+        size_t next = 0;
+        for (size_t round = 0; round < 10; ++round) {
+            for (size_t i = 0; i < 10; ++i) {
+                bufferPool->getPage({"index", i});
+            }
+            for (size_t i = 0; i < 60; ++i) {
+                bufferPool->getPage({"table", next++});
+            }
+        }
+        db::PageStats index = bufferPool->getStats("index");
+        db::PageStats table = bufferPool->getStats("table");
+        EXPECT_EQ(index.hits + index.misses, 100);
+        EXPECT_EQ(table.hits, 0);
+        EXPECT_EQ(table.misses, 600);
+        db::PageStats total = bufferPool->getStats();
+        EXPECT_EQ(total.hits, index.hits);
+        bufferPool->resetStats();
+        EXPECT_EQ(bufferPool->getStats().misses, 0);
+        return index.hits;
+    };
+    EXPECT_EQ(hits(db::Replacement::LRU), 0);
+    EXPECT_EQ(hits(db::Replacement::CLOCK), 0);
+    // The index pages are read again after their first eviction, enter Am and stay there.
+    EXPECT_EQ(hits(db::Replacement::TWO_Q), 80);
+}
+
+TEST(BufferPoolTest, TwoQueueRestore) {
+    db::TwoQueuePolicy policy(8);
+    auto only = [](size_t slot) { return [slot](size_t s) { return s == slot; }; };
+    // Pages read again after their eviction from A1in enter Am.
+    for (size_t slot: {4, 5}) {
+        policy.insert(slot, {"table", slot + 10});
+        EXPECT_EQ(policy.evict(only(slot)), slot);
+        policy.insert(slot, {"table", slot + 10});
+    }
+
+    // A page of A1in that could not be evicted goes back to A1in and not to Am.
+    policy.insert(0, {"table", 0});
+    EXPECT_EQ(policy.evict(only(0)), 0);
+    policy.restore(0);
+    policy.insert(1, {"table", 1});
+    policy.insert(2, {"table", 2});
+    EXPECT_EQ(policy.evict([](size_t) { return true; }), 0);
+}
+
+TEST(BufferPoolTest, TwoQueueReusedId) {
+    db::Database &db = db::getDatabase();
+    db.setBufferPool({.pages = 8, .replacement = db::Replacement::TWO_Q});
+    db::BufferPool &bufferPool = db.getBufferPool();
+    std::remove("old");
+    std::remove("new");
+    db.add(std::make_unique<db::DbFile>("old", db::TupleDesc()));
+    uint32_t id = db.get("old").getId();
+    // Pages 0 to 3 of the old file are evicted from A1in and remembered in A1out.
+    for (size_t i = 0; i < 12; ++i) {
+        bufferPool.getPage({"old", i});
+    }
+    db.remove("old");
+    db.add(std::make_unique<db::DbFile>("new", db::TupleDesc()));
+    ASSERT_EQ(db.get("new").getId(), id);
+
+    // The same pages of the new file are read for the first time: they stay in A1in, and a scan evicts them.
+    for (size_t i = 0; i < 20; ++i) {
+        bufferPool.getPage({"new", i});
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_FALSE(bufferPool.contains({"new", i})) << i;
+    }
+    db.remove("new");
+    db.setBufferPool({});
+}
+
+TEST(BufferPoolTest, Options) {
+    db::Database &db = db::getDatabase();
+    std::remove("sized");
+    db.add(std::make_unique<db::DbFile>("sized", db::TupleDesc()));
+    EXPECT_THROW(db::BufferPool(db::BufferPoolOptions{.pages = 0}), std::invalid_argument);
+
+    for (bool huge: {false, true}) {
+        db.setBufferPool({.pages = 1000, .huge_pages = huge});
+        db::BufferPool &bufferPool = db.getBufferPool();
+        EXPECT_EQ(bufferPool.getNumPages(), 1000);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(bufferPool.pin({"sized", 0}).page().data()) % db::DEFAULT_PAGE_SIZE, 0);
+        for (size_t i = 0; i < 1000; ++i) {
+            db::PageGuard guard = bufferPool.pin({"sized", i}, db::Latch::EXCLUSIVE);
+            guard.page()[0] = static_cast<uint8_t>(i);
+            guard.markDirty();
+        }
+        for (size_t i = 0; i < 1000; ++i) {
+            EXPECT_EQ(bufferPool.getPage({"sized", i})[0], static_cast<uint8_t>(i));
+        }
+        EXPECT_EQ(bufferPool.getStats("sized").misses, 1000);
+    }
+
+    // A smaller pool evicts, and the pages written by the previous pool were flushed when it was replaced.
+    db.setBufferPool({.pages = 8});
+    for (size_t i = 0; i < 1000; ++i) {
+        EXPECT_EQ(db.getBufferPool().getPage({"sized", i})[0], static_cast<uint8_t>(i));
+    }
+    EXPECT_EQ(db.getBufferPool().getStats("sized").misses, 1000);
+    EXPECT_FALSE(db.getBufferPool().contains({"sized", 0}));
+    db.setBufferPool({});
+}
+
+TEST(BufferPoolTest, PageTable) {
+    db::Database &db = db::getDatabase();
+    EXPECT_EQ(db.getId("interned"), db::NO_FILE);
+    // Looking a name up does not intern it.
+    EXPECT_EQ(db::PageId("interned", 7).file, db::NO_FILE);
+    EXPECT_EQ(db.getId("interned"), db::NO_FILE);
+    std::remove("interned");
+    db.add(std::make_unique<db::DbFile>("interned", db::TupleDesc()));
+    uint32_t id = db.getId("interned");
+    EXPECT_NE(id, db::NO_FILE);
+    EXPECT_EQ(db::PageId("interned", 7), db::PageId(id, 7));
+    EXPECT_EQ(db.get(id).getId(), id);
+
+    // The id of a removed file is reused, so files added and removed over and over do not use up ids.
+    db.remove("interned");
+    EXPECT_EQ(db.getId("interned"), db::NO_FILE);
+    EXPECT_THROW(db.get(id), std::logic_error);
+    for (int i = 0; i < 100; ++i) {
+        std::string name = "temp." + std::to_string(i) + ".tmp";
+        db.add(std::make_unique<db::DbFile>(name, db::TupleDesc()));
+        EXPECT_EQ(db.getId(name), id);
+        db.remove(name);
+        std::remove(name.c_str());
+    }
+    std::remove("interned");
+
+    // Random inserts and erases against a reference map, in a few files so that keys collide on the low bits.
+    db::PageTable table;
+    std::unordered_map<db::PageId, size_t, std::hash<const db::PageId>> expected;
+    std::mt19937 rng(0);
+    for (size_t i = 0; i < 100000; ++i) {
+        db::PageId pid(rng() % 4, rng() % 512);
+        if (expected.count(pid)) {
+            EXPECT_EQ(table.find(pid), expected[pid]);
+            EXPECT_TRUE(table.erase(pid));
+            expected.erase(pid);
+        } else {
+            EXPECT_FALSE(table.find(pid).has_value());
+            EXPECT_FALSE(table.erase(pid));
+            table.insert(pid, i);
+            expected[pid] = i;
+        }
+    }
+    EXPECT_EQ(table.size(), expected.size());
+    size_t visited = 0;
+    table.forEach([&](const db::PageId &pid, size_t slot) {
+        EXPECT_EQ(expected.at(pid), slot);
+        ++visited;
+    });
+    EXPECT_EQ(visited, expected.size());
+}
+
+TEST(BufferPoolTest, Prefetch) {
+    db::Database &db = db::getDatabase();
+    db::TupleDesc td({db::type_t::INT, db::type_t::CHAR}, {"id", "name"});
+    std::remove("heapfile.in");
+    std::remove("btree.in");
+    db.add(std::make_unique<db::HeapFile>("heapfile.in", td));
+    db.add(std::make_unique<db::BTreeFile>("btree.in", td, 0));
+    auto &heap = db.get("heapfile.in");
+    auto &btree = db.get("btree.in");
+    for (int i = 0; i < 5000; ++i) {
+        heap.insertTuple({{i, "x"}});
+        btree.insertTuple({{(i * 7919) % 5000, "x"}});
+    }
+    ASSERT_GT(heap.getNumPages(), 20);
+    db.setBufferPool({.prefetch_depth = 4});
+    db::BufferPool &bufferPool = db.getBufferPool();
+    EXPECT_EQ(bufferPool.getPrefetchDepth(), 4);
+
+    // Two consecutive pages start a sequential run.
+    bufferPool.getPage({"heapfile.in", 0});
+    bufferPool.getPage({"heapfile.in", 0});
+    bufferPool.drainPrefetches();
+    EXPECT_FALSE(bufferPool.contains({"heapfile.in", 1}));
+    bufferPool.getPage({"heapfile.in", 1});
+    bufferPool.drainPrefetches();
+    for (size_t page = 2; page <= 5; ++page) EXPECT_TRUE(bufferPool.contains({"heapfile.in", page}));
+    EXPECT_FALSE(bufferPool.contains({"heapfile.in", 6}));
+    bufferPool.getPage({"heapfile.in", 2});
+    bufferPool.drainPrefetches();
+    EXPECT_TRUE(bufferPool.contains({"heapfile.in", 6}));
+    db::PageStats stats = bufferPool.getStats("heapfile.in");
+    EXPECT_EQ(stats.hits, 2);
+    EXPECT_EQ(stats.misses, 2);
+    EXPECT_EQ(stats.prefetched, 5);
+
+    // A random access ends the run; a full scan then only misses its first pages.
+    bufferPool.getPage({"heapfile.in", 15});
+    bufferPool.drainPrefetches();
+    EXPECT_FALSE(bufferPool.contains({"heapfile.in", 16}));
+    size_t count = 0;
+    for (auto it = heap.begin(); it != heap.end(); heap.next(it)) {
+        ++count;
+    }
+    EXPECT_EQ(count, 5000);
+    bufferPool.drainPrefetches();
+    EXPECT_EQ(bufferPool.getStats("heapfile.in").prefetched + bufferPool.getStats("heapfile.in").misses,
+              heap.getNumPages());
+
+    // The prefetcher follows the chain of leaves ahead of a BTreeFile scan.
+    std::vector<size_t> leaves = dynamic_cast<db::BTreeFile &>(btree).leaves();
+    ASSERT_GT(leaves.size(), 10);
+    db.setBufferPool({.prefetch_depth = 4});
+    auto it = btree.begin();
+    while (it.page == leaves[0]) btree.next(it);
+    db.getBufferPool().drainPrefetches();
+    for (size_t i = 2; i <= 5; ++i) EXPECT_TRUE(db.getBufferPool().contains({"btree.in", leaves[i]})) << i;
+    EXPECT_FALSE(db.getBufferPool().contains({"btree.in", leaves[6]}));
+    // Each further leaf only requests the one that enters the window.
+    size_t prefetched = db.getBufferPool().getStats("btree.in").prefetched;
+    btree.getTuple(it);
+    while (it.page == leaves[1]) btree.next(it);
+    db.getBufferPool().drainPrefetches();
+    EXPECT_TRUE(db.getBufferPool().contains({"btree.in", leaves[6]}));
+    EXPECT_FALSE(db.getBufferPool().contains({"btree.in", leaves[7]}));
+    EXPECT_EQ(db.getBufferPool().getStats("btree.in").prefetched, prefetched + 1);
+    db.setBufferPool({});
+}
+
+TEST(BufferPoolTest, IoQueue) {
+    db::Database &db = db::getDatabase();
+    std::remove("batched");
+    db.add(std::make_unique<db::DbFile>("batched", db::TupleDesc()));
+    db::DbFile &file = db.get("batched");
+
+    // Batches longer than the queue are submitted in several rounds.
+    db::IoQueue queue(8);
+    std::vector<db::Page> pages(100);
+    std::vector<db::IoRequest> requests;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        pages[i].fill(static_cast<uint8_t>(i));
+        requests.push_back(file.writeRequest(pages[i], i));
+    }
+    queue.run(requests);
+    for (const auto &request: requests) EXPECT_EQ(request.result, db::DEFAULT_PAGE_SIZE);
+    requests.clear();
+    for (size_t i = 0; i < pages.size(); ++i) {
+        requests.push_back(file.readRequest(pages[pages.size() - 1 - i], i));
+    }
+    queue.run(requests);
+    for (size_t i = 0; i < pages.size(); ++i) {
+        EXPECT_EQ(requests[i].result, db::DEFAULT_PAGE_SIZE);
+        EXPECT_EQ(pages[pages.size() - 1 - i][db::DEFAULT_PAGE_SIZE - 1], static_cast<uint8_t>(i));
+    }
+    EXPECT_EQ(file.getWrites().size(), 100);
+    EXPECT_EQ(file.getReads().size(), 100);
+
+    // flushFile writes the dirty pages of the file, and only them, in one batch.
+    db::BufferPool &bufferPool = db.getBufferPool();
+    for (size_t i = 0; i < 10; ++i) {
+        db::PageGuard guard = bufferPool.pin({"batched", i}, db::Latch::EXCLUSIVE);
+        guard.page()[0] = 0xff;
+        if (i % 2 == 0) guard.markDirty();
+    }
+    bufferPool.flushFile("batched");
+    EXPECT_EQ(file.getWrites().size(), 105);
+    for (size_t i = 0; i < 10; ++i) EXPECT_FALSE(bufferPool.isDirty({"batched", i}));
+    bufferPool.discardFile("batched");
+    for (size_t i = 0; i < 10; ++i) EXPECT_EQ(bufferPool.getPage({"batched", i})[0], i % 2 == 0 ? 0xff : i);
+    db.remove("batched");
+}
+
+TEST(BufferPoolTest, BackgroundFlush) {
+    db::Database &db = db::getDatabase();
+    std::remove("trickled");
+    db.add(std::make_unique<db::DbFile>("trickled", db::TupleDesc()));
+    db::DbFile &file = db.get("trickled");
+    EXPECT_THROW(db::BufferPool(db::BufferPoolOptions{.dirty_threshold = 2}), std::invalid_argument);
+    db.setBufferPool({.dirty_threshold = 0.1});
+    db::BufferPool &bufferPool = db.getBufferPool();
+
+    // The pages are latched while they are modified, and written back once released, in runs of consecutive pages.
+    {
+        std::vector<db::PageGuard> guards;
+        for (size_t i = 0; i < 20; ++i) {
+            if (i == 10) continue;
+            guards.push_back(bufferPool.pin({"trickled", i}, db::Latch::EXCLUSIVE));
+            guards.back().page()[0] = static_cast<uint8_t>(i + 1);
+            guards.back().markDirty();
+        }
+        EXPECT_DOUBLE_EQ(bufferPool.getDirtyRatio(), 19.0 / db::DEFAULT_NUM_PAGES);
+    }
+    for (int i = 0; i < 500 && bufferPool.getDirtyRatio() > 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(bufferPool.getDirtyRatio(), 0);
+    db::FlushStats stats = bufferPool.getFlushStats();
+    EXPECT_EQ(stats.pages, 19);
+    EXPECT_GE(stats.writes, 2);
+    EXPECT_LT(stats.writes, 19);
+    EXPECT_GT(stats.rate, 0);
+    EXPECT_EQ(file.getWrites().size(), 19);
+
+    // Below the threshold, dirty pages are left to eviction.
+    bufferPool.getPage({"trickled", 30})[0] = 31;
+    bufferPool.markDirty({"trickled", 30});
+    std::this_thread::sleep_for(db::FLUSH_INTERVAL * 5);
+    EXPECT_TRUE(bufferPool.isDirty({"trickled", 30}));
+    bufferPool.resetStats();
+    EXPECT_EQ(bufferPool.getFlushStats().pages, 0);
+
+    db.setBufferPool({});
+    for (size_t i = 0; i <= 30; ++i) {
+        if (i < 20 || i == 30) {
+            EXPECT_EQ(db.getBufferPool().getPage({"trickled", i})[0], i == 10 ? 0 : i + 1);
+        }
+    }
+    db.remove("trickled");
+}
+
+TEST(BufferPoolTest, DiscardWhileFlushing) {
+    db::Database &db = db::getDatabase();
+    std::remove("bulk");
+    db.add(std::make_unique<db::DbFile>("bulk", db::TupleDesc(), db::MAX_PAGE_SIZE));
+    db.setBufferPool({.pages = 512, .dirty_threshold = 0.05});
+    db::BufferPool &bufferPool = db.getBufferPool();
+    db::TupleDesc td({db::type_t::INT, db::type_t::CHAR, db::type_t::CHAR}, {"id", "a", "b"});
+    db::Page page{};
+    const size_t perPage = db::HeapPage(page, td).end();
+
+    // Another file keeps the writer busy, so that temporary files are dropped while it holds their pages.
+    std::atomic<bool> stop = false;
+    std::thread dirtier([&] {
+        for (uint8_t round = 0; !stop; ++round) {
+            for (size_t i = 0; i < 400; ++i) {
+                db::PageGuard guard = bufferPool.pin({"bulk", i}, db::Latch::EXCLUSIVE);
+                guard.page()[0] = round;
+                guard.markDirty();
+            }
+        }
+    });
+    for (int round = 0; round < 2000; ++round) {
+        std::string name;
+        {
+            db::TempFile temp("flushing", td);
+            name = temp.file().getName();
+            for (int i = 0; i < perPage; ++i) {
+                temp.file().insertTuple({{i, "a", "b"}});
+            }
+        }
+        EXPECT_EQ(db.getId(name), db::NO_FILE);
+    }
+    stop = true;
+    dirtier.join();
+    db.setBufferPool({});
+    db.remove("bulk");
+}
+
+TEST(BufferPoolTest, MappedFile) {
+    db::Database &db = db::getDatabase();
+    db::TupleDesc td({db::type_t::INT, db::type_t::CHAR}, {"id", "name"});
+    std::remove("mapped");
+    std::remove("mapped.idx");
+    db.add(std::make_unique<db::HeapFile>("mapped", td));
+    db.add(std::make_unique<db::BTreeFile>("mapped.idx", td, 0));
+    auto &heap = db.get("mapped");
+    auto &btree = db.get("mapped.idx");
+    for (int i = 0; i < 3000; ++i) {
+        heap.insertTuple({{i, "x"}});
+        btree.insertTuple({{(i * 7919) % 3000, "x"}});
+    }
+
+    // The dirty pages are flushed before the file is mapped, and the scans do not go through the pool.
+    heap.map();
+    btree.map();
+    EXPECT_TRUE(heap.isMapped());
+    db::BufferPool &bufferPool = db.getBufferPool();
+    EXPECT_FALSE(bufferPool.contains({"mapped", 0}));
+    bufferPool.resetStats();
+    int expected = 0;
+    for (auto it = heap.begin(); it != heap.end(); heap.next(it)) {
+        EXPECT_EQ(std::get<int>(heap.getTuple(it).get_field(0)), expected++);
+    }
+    EXPECT_EQ(expected, 3000);
+    EXPECT_EQ(bufferPool.getStats("mapped").hits + bufferPool.getStats("mapped").misses, 0);
+    expected = 0;
+    for (auto it = btree.begin(); it != btree.end(); btree.next(it)) {
+        EXPECT_EQ(std::get<int>(btree.getTuple(it).get_field(0)), expected++);
+    }
+    EXPECT_EQ(expected, 3000);
+
+    // Mapped files are read-only.
+    EXPECT_THROW(heap.insertTuple({{0, "x"}}), std::logic_error);
+    EXPECT_THROW(heap.deleteTuple(heap.begin()), std::logic_error);
+    EXPECT_THROW(btree.insertTuple({{0, "x"}}), std::logic_error);
+    EXPECT_THROW(heap.pinForRead(0).markDirty(), std::logic_error);
+    heap.unmap();
+    EXPECT_FALSE(heap.isMapped());
+    heap.insertTuple({{3000, "x"}});
+    EXPECT_TRUE(bufferPool.contains({"mapped", heap.getNumPages() - 1}));
+    db.remove("mapped");
+    db.remove("mapped.idx");
+
+    // A partial page at the end of the file is not mapped but read through the pool.
+    std::remove("partial");
+    {
+        std::ofstream out("partial", std::ios::binary);
+        std::vector<char> bytes(2 * db::DEFAULT_PAGE_SIZE + 100, 1);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+    db.add(std::make_unique<db::HeapFile>("partial", td));
+    auto &partial = db.get("partial");
+    partial.map();
+    EXPECT_TRUE(partial.isMapped());
+    EXPECT_EQ(partial.pinForRead(1).page()[0], 1);
+    EXPECT_FALSE(bufferPool.contains({"partial", 1}));
+    {
+        auto tail = partial.pinForRead(2);
+        EXPECT_EQ(tail.page()[99], 1);
+        EXPECT_EQ(tail.page()[100], 0);
+    }
+    EXPECT_TRUE(bufferPool.contains({"partial", 2}));
+    partial.unmap();
+    bufferPool.discardFile("partial");
+    db.remove("partial");
+    std::remove("partial");
+}
+
+TEST(BufferPoolTest, DirectIo) {
+    db::Database &db = db::getDatabase();
+    db::TupleDesc td({db::type_t::INT, db::type_t::CHAR}, {"id", "name"});
+    std::remove("direct");
+    db.add(std::make_unique<db::HeapFile>("direct", td));
+    auto &heap = db.get("direct");
+    heap.setDirect(true);
+    EXPECT_TRUE(heap.isDirect());
+    for (int i = 0; i < 2000; ++i) {
+        heap.insertTuple({{i, "x"}});
+    }
+    db::BufferPool &bufferPool = db.getBufferPool();
+    bufferPool.flushFile("direct");
+    bufferPool.discardFile("direct");
+    int expected = 0;
+    for (auto it = heap.begin(); it != heap.end(); heap.next(it)) {
+        EXPECT_EQ(std::get<int>(heap.getTuple(it).get_field(0)), expected++);
+    }
+    EXPECT_EQ(expected, 2000);
+
+    // Pages outside the pool are copied through an aligned buffer, except by the requests of an IoQueue.
+    auto buffer = std::make_unique<uint8_t[]>(2 * db::DEFAULT_PAGE_SIZE);
+    auto *page = reinterpret_cast<db::Page *>(buffer.get() + (db::DIRECT_IO_ALIGNMENT -
+                                                              reinterpret_cast<uintptr_t>(buffer.get()) % db::DIRECT_IO_ALIGNMENT + 1));
+    heap.readPage(*page, 0);
+    db::Page copy = *page;
+    page->fill(7);
+    heap.writePage(*page, heap.getNumPages());
+    heap.readPage(*page, 0);
+    EXPECT_EQ(*page, copy);
+    heap.readPage(*page, heap.getNumPages());
+    EXPECT_EQ((*page)[db::DEFAULT_PAGE_SIZE - 1], 7);
+    EXPECT_THROW(heap.readRequest(*page, 0), std::invalid_argument);
+    heap.setDirect(false);
+    EXPECT_FALSE(heap.isDirect());
+    db.remove("direct");
+}
+
+TEST(BufferPoolTest, PageSize) {
+    db::Database &db = db::getDatabase();
+    db::TupleDesc td({db::type_t::INT, db::type_t::CHAR}, {"id", "name"});
+    std::remove("wide");
+    std::remove("wide.idx");
+    EXPECT_THROW(db::HeapFile("wide", td, 12288), std::invalid_argument);
+    EXPECT_THROW(db::BufferPool(db::BufferPoolOptions{.page_size = 128 << 10}), std::invalid_argument);
+    db.add(std::make_unique<db::HeapFile>("wide", td, 16384));
+    db.add(std::make_unique<db::BTreeFile>("wide.idx", td, 0, 65536));
+    auto &heap = db.get("wide");
+    auto &btree = db.get("wide.idx");
+    EXPECT_EQ(heap.getPageSize(), 16384);
+
+    // A pool whose frames are smaller than the pages of a file cannot hold them, the default one holds every size.
+    db.setBufferPool({.page_size = db::DEFAULT_PAGE_SIZE});
+    EXPECT_THROW(heap.insertTuple({{0, "x"}}), std::logic_error);
+    db.setBufferPool({});
+    EXPECT_EQ(db.getBufferPool().getPageSize(), db::MAX_PAGE_SIZE);
+    for (int i = 0; i < 5000; ++i) {
+        heap.insertTuple({{i, "x"}});
+        btree.insertTuple({{(i * 7919) % 5000, "x"}});
+    }
+    db::Page small{};
+    EXPECT_EQ(db::HeapPage(db.getBufferPool().pin({"wide", 0}).page(), td).end(), 4 * db::HeapPage(small, td).end());
+    // Memory budgets in pages of the file count as many tuples as its pages hold.
+    EXPECT_EQ(db::tuples_per_page(td, heap.getPageSize()), 4 * db::HeapPage(small, td).end());
+    size_t heapPages = heap.getNumPages();
+    size_t leaves = dynamic_cast<db::BTreeFile &>(btree).leaves().size();
+    EXPECT_LE(leaves, 16);
+
+    // The page size survives reopening: it is read from the header, whatever size is asked for.
+    db.setBufferPool({});
+    db.remove("wide");
+    db.remove("wide.idx");
+    struct stat st{};
+    ASSERT_EQ(stat("wide", &st), 0);
+    EXPECT_EQ(st.st_size, db::FILE_HEADER_SIZE + heapPages * 16384);
+    db.add(std::make_unique<db::HeapFile>("wide", td));
+    db.add(std::make_unique<db::BTreeFile>("wide.idx", td, 0));
+    EXPECT_EQ(db.get("wide").getPageSize(), 16384);
+    EXPECT_EQ(db.get("wide").getNumPages(), heapPages);
+    EXPECT_EQ(db.get("wide.idx").getPageSize(), 65536);
+    int expected = 0;
+    auto &reopened = db.get("wide");
+    for (auto it = reopened.begin(); it != reopened.end(); reopened.next(it)) {
+        EXPECT_EQ(std::get<int>(reopened.getTuple(it).get_field(0)), expected++);
+    }
+    EXPECT_EQ(expected, 5000);
+    expected = 0;
+    auto &index = db.get("wide.idx");
+    for (auto it = index.begin(); it != index.end(); index.next(it)) {
+        EXPECT_EQ(std::get<int>(index.getTuple(it).get_field(0)), expected++);
+    }
+    EXPECT_EQ(expected, 5000);
+
+    // Mapped, the pages are read in place past the header.
+    reopened.map();
+    expected = 0;
+    for (auto it = reopened.begin(); it != reopened.end(); reopened.next(it)) {
+        EXPECT_EQ(std::get<int>(reopened.getTuple(it).get_field(0)), expected++);
+    }
+    EXPECT_EQ(expected, 5000);
+    db.setBufferPool({});
+    db.remove("wide");
+    db.remove("wide.idx");
+}
+
+TEST(BufferPoolTest, FrameMemory) {
+    if (sysconf(_SC_PAGESIZE) != db::DEFAULT_PAGE_SIZE) {
+        GTEST_SKIP() << "Residency is counted in pages of DEFAULT_PAGE_SIZE";
+    }
+    db::Database &db = db::getDatabase();
+    std::remove("large");
+    std::remove("small");
+    db.add(std::make_unique<db::DbFile>("large", db::TupleDesc(), db::MAX_PAGE_SIZE));
+    db.add(std::make_unique<db::DbFile>("small", db::TupleDesc()));
+    auto resident = [](const uint8_t *start, size_t size) {
+        std::vector<unsigned char> pages(size / db::DEFAULT_PAGE_SIZE);
+        EXPECT_EQ(mincore(const_cast<uint8_t *>(start), size, pages.data()), 0);
+        return std::count_if(pages.begin(), pages.end(), [](unsigned char page) { return page & 1; });
+    };
+
+    // A single frame holds the pages of both files in turn, and only keeps the memory of the page it holds.
+    auto bufferPool = std::make_unique<db::BufferPool>(db::BufferPoolOptions{.pages = 1});
+    std::span<uint8_t> large = bufferPool->getPageBytes({"large", 0});
+    EXPECT_EQ(large.size(), db::MAX_PAGE_SIZE);
+    EXPECT_EQ(resident(large.data(), db::MAX_PAGE_SIZE), db::MAX_PAGE_SIZE / db::DEFAULT_PAGE_SIZE);
+    std::span<uint8_t> small = bufferPool->getPageBytes({"small", 0});
+    EXPECT_EQ(small.data(), large.data());
+    EXPECT_EQ(small.size(), db::DEFAULT_PAGE_SIZE);
+    EXPECT_EQ(resident(large.data(), db::MAX_PAGE_SIZE), 1);
+    bufferPool.reset();
+    db.remove("large");
+    db.remove("small");
+}
@@ -0,0 +1,181 @@
+#include <db/BTreeFile.hpp>
+#include <db/Database.hpp>
+#include <db/Executor.hpp>
+#include <db/HeapFile.hpp>
+#include <db/HeapPage.hpp>
+#include <gtest/gtest.h>
+
+static std::vector<db::Tuple> contents(const db::DbFile &file) {
+    std::vector<db::Tuple> tuples;
+    for (auto it = file.begin(); it != file.end(); file.next(it)) tuples.push_back(file.getTuple(it));
+    return tuples;
+}
+
+static void expectSame(const db::DbFile &expected, const db::DbFile &actual) {
+    auto e = contents(expected), a = contents(actual);
+    ASSERT_EQ(e.size(), a.size());
+    for (size_t i = 0; i < e.size(); ++i) {
+        for (size_t f = 0; f < e[i].size(); ++f) EXPECT_EQ(e[i].get_field(f), a[i].get_field(f)) << i;
+    }
+}
+
+TEST(ExecutorTest, FilterAndProjection) {
+    std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+    std::vector<std::string> names{"id", "name", "price"};
+    db::TupleDesc td(types, names);
+    db::TupleDesc projected({db::type_t::DOUBLE, db::type_t::INT}, {"price", "id"});
+
+    for (const char *name: {"heapfile.in", "serial.out", "parallel.out", "serial.proj", "parallel.proj"}) {
+        std::remove(name);
+    }
+    db::getDatabase().add(std::make_unique<db::HeapFile>("heapfile.in", td));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("serial.out", td));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("parallel.out", td));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("serial.proj", projected));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("parallel.proj", projected));
+    auto &in = db::getDatabase().get("heapfile.in");
+    for (int i = 0; i < 20000; ++i) {
+        in.insertTuple({{i, i % 3 ? "x" : "y", (i % 1000) * 0.5}});
+    }
+    for (auto it = in.begin(); it != in.end(); in.next(it)) {
+        if (std::get<int>(in.getTuple(it).get_field(0)) % 7 == 0) in.deleteTuple(it);
+    }
+    EXPECT_GT(in.getNumPages(), 4 * db::MORSEL_PAGES);
+
+    std::vector<db::FilterPredicate> pred{{"price", db::PredicateOp::GE, 100.0}, {"name", db::PredicateOp::EQ, "x"}};
+    db::Executor executor(4);
+    db::filter(in, db::getDatabase().get("serial.out"), pred);
+    executor.filter(in, db::getDatabase().get("parallel.out"), pred);
+    expectSame(db::getDatabase().get("serial.out"), db::getDatabase().get("parallel.out"));
+
+    db::projection(db::getDatabase().get("serial.out"), db::getDatabase().get("serial.proj"), {"price", "id"});
+    executor.projection(in, db::getDatabase().get("parallel.proj"), {"price", "id"}, pred);
+    expectSame(db::getDatabase().get("serial.proj"), db::getDatabase().get("parallel.proj"));
+}
+
+TEST(ExecutorTest, Aggregate) {
+    std::vector<db::type_t> types{db::type_t::INT, db::type_t::INT, db::type_t::DOUBLE};
+    std::vector<std::string> names{"id", "bucket", "price"};
+    db::TupleDesc td(types, names);
+    db::TupleDesc grouped({db::type_t::INT, db::type_t::INT, db::type_t::INT, db::type_t::DOUBLE},
+                          {"bucket", "sum", "count", "min"});
+
+    for (const char *name: {"heapfile.in", "filtered.in", "serial.out", "parallel.out"}) std::remove(name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>("heapfile.in", td));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("filtered.in", td));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("serial.out", grouped));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("parallel.out", grouped));
+    auto &in = db::getDatabase().get("heapfile.in");
+    for (int i = 0; i < 30000; ++i) {
+        in.insertTuple({{i, (i * 7919) % 101, (i % 997) * 0.25}});
+    }
+
+    db::GroupBy agg{{"bucket"}, {{db::AggregateOp::SUM, "id"},
+                                 {db::AggregateOp::COUNT, "id"},
+                                 {db::AggregateOp::MIN, "price"}}};
+    std::vector<db::FilterPredicate> pred{{"id", db::PredicateOp::NE, 12345}};
+    db::filter(in, db::getDatabase().get("filtered.in"), pred);
+    db::aggregate(db::getDatabase().get("filtered.in"), db::getDatabase().get("serial.out"), agg);
+
+    db::Executor(8).aggregate(in, db::getDatabase().get("parallel.out"), agg, pred);
+    expectSame(db::getDatabase().get("serial.out"), db::getDatabase().get("parallel.out"));
+}
+
+TEST(ExecutorTest, AggregateStealing) {
+    db::TupleDesc td({db::type_t::INT, db::type_t::INT, db::type_t::INT}, {"id", "key", "keep"});
+    db::TupleDesc grouped({db::type_t::INT, db::type_t::INT, db::type_t::INT}, {"key", "count", "sum"});
+
+    for (const char *name: {"heapfile.in", "filtered.in", "serial.out", "parallel.out"}) std::remove(name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>("heapfile.in", td));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("filtered.in", td));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("serial.out", grouped));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("parallel.out", grouped));
+    auto &in = db::getDatabase().get("heapfile.in");
+
+    // Every morsel of the first half starts new groups and all of its tuples are kept. The second half only keeps a
+    // tuple per group, in the reverse order: the second worker is done with it long before the first worker is done
+    // with its own half, and steals its morsels after having seen their groups later in the file.
+    db::Page page{};
+    const int half = 4 * db::MORSEL_PAGES * db::HeapPage(page, td).end();
+    const int groups = (half + 49) / 50;
+    for (int i = 0; i < half; ++i) {
+        in.insertTuple({{i, i / 50, 1}});
+    }
+    for (int i = 0; i < half; ++i) {
+        in.insertTuple({{half + i, groups - 1 - i / 50, i % 50 == 0 ? 1 : 0}});
+    }
+    EXPECT_EQ(in.getNumPages(), 8 * db::MORSEL_PAGES);
+
+    db::GroupBy agg{{"key"}, {{db::AggregateOp::COUNT, "id"}, {db::AggregateOp::SUM, "id"}}};
+    std::vector<db::FilterPredicate> pred{{"keep", db::PredicateOp::EQ, 1}};
+    db::filter(in, db::getDatabase().get("filtered.in"), pred);
+    db::aggregate(db::getDatabase().get("filtered.in"), db::getDatabase().get("serial.out"), agg);
+
+    db::Executor(2).aggregate(in, db::getDatabase().get("parallel.out"), agg, pred);
+    expectSame(db::getDatabase().get("serial.out"), db::getDatabase().get("parallel.out"));
+}
+
+TEST(ExecutorTest, BTreeLeaves) {
+    std::vector<db::type_t> types{db::type_t::INT, db::type_t::INT};
+    std::vector<std::string> names{"key", "value"};
+    db::TupleDesc td(types, names);
+
+    for (const char *name: {"btree.in", "btree.out"}) std::remove(name);
+    db::getDatabase().add(std::make_unique<db::BTreeFile>("btree.in", td, 0));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("btree.out", td));
+    auto &in = db::getDatabase().get("btree.in");
+    db::Executor executor(3);
+    EXPECT_EQ(executor.scan(in, {}, [](size_t, size_t, db::Batch &) { FAIL(); }), 0);
+
+    for (int i = 0; i < 20000; ++i) {
+        int key = (i * 7919) % 20000;
+        in.insertTuple({{key, -key}});
+    }
+    executor.filter(in, db::getDatabase().get("btree.out"), {{"key", db::PredicateOp::LT, 15000}});
+
+    // The leaves are scanned in parallel but merged in key order.
+    int expected = 0;
+    for (const auto &t: db::getDatabase().get("btree.out")) {
+        EXPECT_EQ(std::get<int>(t.get_field(0)), expected);
+        EXPECT_EQ(std::get<int>(t.get_field(1)), -expected);
+        ++expected;
+    }
+    EXPECT_EQ(expected, 15000);
+}
+
+TEST(ExecutorTest, HashJoin) {
+    db::TupleDesc td1({db::type_t::INT, db::type_t::CHAR}, {"id", "name"});
+    db::TupleDesc td2({db::type_t::INT, db::type_t::INT}, {"quantity", "id"});
+    db::TupleDesc td3({db::type_t::INT, db::type_t::CHAR, db::type_t::INT}, {"id", "name", "quantity"});
+
+    for (const char *name: {"left.in", "right.in", "serial.out", "parallel.out"}) std::remove(name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>("left.in", td1));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("right.in", td2));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("serial.out", td3));
+    db::getDatabase().add(std::make_unique<db::HeapFile>("parallel.out", td3));
+    auto &left = db::getDatabase().get("left.in");
+    auto &right = db::getDatabase().get("right.in");
+    for (int i = 0; i < 3000; ++i) {
+        left.insertTuple({{i % 1500, "name" + std::to_string(i)}});
+    }
+    for (int i = 0; i < 20000; ++i) {
+        right.insertTuple({{i, (i * 31) % 2000}});
+    }
+
+    db::JoinPredicate pred{"id", db::PredicateOp::EQ, "id"};
+    db::hash_join(left, right, db::getDatabase().get("serial.out"), pred);
+    db::Executor(4).join(left, right, db::getDatabase().get("parallel.out"), pred);
+
+    // Matches of the same probe tuple may come out in another order.
+    auto key = [](const db::Tuple &t) {
+        return std::make_tuple(std::get<int>(t.get_field(0)), std::get<std::string>(t.get_field(1)),
+                               std::get<int>(t.get_field(2)));
+    };
+    std::vector<std::tuple<int, std::string, int>> expected, actual;
+    for (const auto &t: contents(db::getDatabase().get("serial.out"))) expected.push_back(key(t));
+    for (const auto &t: contents(db::getDatabase().get("parallel.out"))) actual.push_back(key(t));
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    EXPECT_EQ(expected.size(), 3000 * 10);
+    EXPECT_EQ(expected, actual);
+}
@@ -1,7 +1,10 @@
 #include <db/Database.hpp>
 #include <db/HeapFile.hpp>
+#include <db/Kernels.hpp>
 #include <db/Query.hpp>
 #include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
 
 TEST(FilterTest, All) {
     std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
@@ -85,3 +88,92 @@ TEST(FilterTest, None) {
 
     EXPECT_EQ(out.begin(), out.end());
 }
+
+TEST(FilterTest, ManyBatches) {
+    std::vector<db::type_t> types{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+    std::vector<std::string> names{"id", "name", "price"};
+    db::TupleDesc td(types, names);
+
+    const char *in_name = "heapfile.in";
+    const char *out_name = "heapfile.out";
+    std::remove(in_name);
+    std::remove(out_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(in_name, td));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(out_name, td));
+    auto &in = db::getDatabase().get(in_name);
+    auto &out = db::getDatabase().get(out_name);
+    for (int i = 0; i < 3000; ++i) {
+        in.insertTuple({{i, i % 2 ? "odd" : "even", i * 0.5}});
+    }
+    // Empty slots in the middle of pages must be skipped.
+    for (auto it = in.begin(); it != in.end(); ++it) {
+        if (get<int>(in.getTuple(it).get_field(0)) % 3 == 0) in.deleteTuple(it);
+    }
+
+    db::FilterPredicate pred1{"name", db::PredicateOp::EQ, "odd"};
+    db::FilterPredicate pred2{"price", db::PredicateOp::LT, 1000.0};
+    db::filter(in, out, {pred1, pred2});
+
+    int count = 0;
+    for (const auto &t: out) {
+        int id = get<int>(t.get_field(0));
+        EXPECT_EQ(id % 2, 1);
+        EXPECT_NE(id % 3, 0);
+        EXPECT_EQ(get<std::string>(t.get_field(1)), "odd");
+        EXPECT_LT(id, 2000);
+        ++count;
+    }
+    EXPECT_EQ(count, 667);
+
+    // A value of another type matches nothing.
+    std::remove(out_name);
+    db::getDatabase().remove(out_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(out_name, td));
+    db::filter(in, db::getDatabase().get(out_name), {{"id", db::PredicateOp::GE, 0.0}});
+    EXPECT_EQ(db::getDatabase().get(out_name).begin(), db::getDatabase().get(out_name).end());
+}
+
+TEST(FilterTest, SimdKernels) {
+    // Values of a 20-byte row: an int at offset 3 and a double at offset 9, like an unaligned page layout.
+    constexpr size_t stride = 20, n = 203;
+    std::vector<uint8_t> data(n * stride);
+    for (size_t i = 0; i < n; ++i) {
+        int x = static_cast<int>(i % 17) - 8;
+        double y = i % 13 == 0 ? NAN : x * 0.5;
+        std::memcpy(&data[i * stride + 3], &x, sizeof(x));
+        std::memcpy(&data[i * stride + 9], &y, sizeof(y));
+    }
+    std::vector<db::PredicateOp> ops{db::PredicateOp::EQ, db::PredicateOp::NE, db::PredicateOp::LT,
+                                     db::PredicateOp::LE, db::PredicateOp::GT, db::PredicateOp::GE};
+    auto test = [](auto x, db::PredicateOp op, auto v) {
+        switch (op) {
+            case db::PredicateOp::EQ: return x == v;
+            case db::PredicateOp::NE: return x != v;
+            case db::PredicateOp::LT: return x < v;
+            case db::PredicateOp::LE: return x <= v;
+            case db::PredicateOp::GT: return x > v;
+            case db::PredicateOp::GE: return x >= v;
+        }
+        return false;
+    };
+
+    for (auto level: {db::SimdLevel::SCALAR, db::SimdLevel::SSE2, db::SimdLevel::AVX2}) {
+        db::set_simd_level(level);
+        for (auto op: ops) {
+            std::vector<uint8_t> ints((n + 7) / 8, 0xFF), doubles((n + 7) / 8, 0xFF);
+            db::select_int(&data[3], stride, n, op, 2, ints.data());
+            db::select_double(&data[9], stride, n, op, 1.0, doubles.data());
+            for (size_t i = 0; i < n; ++i) {
+                int x;
+                double y;
+                std::memcpy(&x, &data[i * stride + 3], sizeof(x));
+                std::memcpy(&y, &data[i * stride + 9], sizeof(y));
+                EXPECT_EQ(bool(ints[i / 8] & (1 << (7 - i % 8))), test(x, op, 2)) << i;
+                EXPECT_EQ(bool(doubles[i / 8] & (1 << (7 - i % 8))), test(y, op, 1.0)) << i;
+            }
+            // Bits past the last slot are cleared.
+            EXPECT_EQ(ints.back() & 0x1F, 0);
+        }
+    }
+    db::set_simd_level(db::detect_simd_level());
+}
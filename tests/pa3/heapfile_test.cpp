@@ -0,0 +1,78 @@
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/HeapPage.hpp>
+#include <gtest/gtest.h>
+
+TEST(HeapFileTest, FreeSpaceMap) {
+    db::TupleDesc td({db::type_t::INT, db::type_t::CHAR}, {"id", "name"});
+    const char *name = "churn.in";
+    std::string map = std::string(name) + db::FREE_SPACE_MAP_SUFFIX;
+    std::remove(name);
+    std::remove(map.c_str());
+    db::Database &db = db::getDatabase();
+    db.add(std::make_unique<db::HeapFile>(name, td));
+    auto &file = db.get(name);
+
+    // Without deletes, the pages are filled in order.
+    db::Page page{};
+    const size_t perPage = db::HeapPage(page, td).end();
+    for (int i = 0; i < 10 * perPage; ++i) {
+        file.insertTuple({{i, "x"}});
+    }
+    EXPECT_EQ(file.getNumPages(), 10);
+    int expected = 0;
+    for (auto it = file.begin(); it != file.end(); file.next(it)) {
+        EXPECT_EQ(std::get<int>(file.getTuple(it).get_field(0)), expected++);
+    }
+
+    // The slots freed by deletes are reused before the file grows.
+    for (int round = 0; round < 20; ++round) {
+        size_t deleted = 0;
+        for (auto it = file.begin(); it != file.end(); file.next(it)) {
+            if ((std::get<int>(file.getTuple(it).get_field(0)) + round) % 3 == 0) {
+                file.deleteTuple(it);
+                ++deleted;
+            }
+        }
+        for (size_t i = 0; i < deleted; ++i) {
+            file.insertTuple({{static_cast<int>(3 * i + 3 - round % 3), "y"}});
+        }
+        EXPECT_EQ(file.getNumPages(), 10);
+    }
+    size_t count = 0;
+    for (auto it = file.begin(); it != file.end(); file.next(it)) {
+        ++count;
+    }
+    EXPECT_EQ(count, 10 * perPage);
+
+    // Reopened, the map is loaded from its side file: the hole on page 3 is filled first, without reading other pages.
+    auto hole = file.begin();
+    while (hole.page != 3) file.next(hole);
+    file.deleteTuple(hole);
+    db.remove(name);
+    db.add(std::make_unique<db::HeapFile>(name, td));
+    auto &reopened = db.get(name);
+    reopened.insertTuple({{-1, "z"}});
+    EXPECT_EQ(reopened.getReads(), std::vector<size_t>{3});
+    reopened.insertTuple({{-2, "z"}});
+    EXPECT_EQ(reopened.getNumPages(), 11);
+    auto it = reopened.begin();
+    while (it.page != 3) reopened.next(it);
+    bool found = false;
+    for (; it.page == 3; reopened.next(it)) {
+        found |= std::get<int>(reopened.getTuple(it).get_field(0)) == -1;
+    }
+    EXPECT_TRUE(found);
+    db.remove(name);
+
+    // Without the side file, the pages are read from the last one back until one has a free slot.
+    std::remove(map.c_str());
+    db.add(std::make_unique<db::HeapFile>(name, td));
+    auto &unmapped = db.get(name);
+    unmapped.insertTuple({{-3, "z"}});
+    EXPECT_EQ(unmapped.getReads(), std::vector<size_t>{10});
+    EXPECT_EQ(unmapped.getNumPages(), 11);
+    db.remove(name);
+    std::remove(name);
+    std::remove(map.c_str());
+}
@@ -1,7 +1,9 @@
+#include <db/BTreeFile.hpp>
 #include <db/Database.hpp>
 #include <db/HeapFile.hpp>
 #include <db/Query.hpp>
 #include <gtest/gtest.h>
+#include <limits>
 #include <random>
 
 TEST(JoinTest, Small) {
@@ -158,3 +160,328 @@ TEST(JoinTest, Large) {
     }
     EXPECT_EQ(i, expected);
 }
+
+TEST(JoinTest, HashJoinBuildLeft) {
+    std::vector<db::type_t> types1{db::type_t::INT, db::type_t::CHAR};
+    std::vector<std::string> names1{"id", "name"};
+    db::TupleDesc td1(types1, names1);
+
+    std::vector<db::type_t> types2{db::type_t::INT, db::type_t::INT};
+    std::vector<std::string> names2{"quantity", "id"};
+    db::TupleDesc td2(types2, names2);
+
+    std::vector<db::type_t> types3{db::type_t::INT, db::type_t::CHAR, db::type_t::INT};
+    std::vector<std::string> names3{"id", "name", "quantity"};
+    db::TupleDesc td3(types3, names3);
+
+    const char *left_name = "left.in";
+    const char *right_name = "right.in";
+    const char *out_name = "heapfile.out";
+    std::remove(left_name);
+    std::remove(right_name);
+    std::remove(out_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(left_name, td1));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(right_name, td2));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(out_name, td3));
+    auto &left = db::getDatabase().get(left_name);
+    auto &right = db::getDatabase().get(right_name);
+    auto &out = db::getDatabase().get(out_name);
+
+    // The left table is smaller, so it becomes the build side. Keys repeat on both sides.
+    for (int i = 0; i < 20; ++i) {
+        left.insertTuple({{i % 10, "Hello"}});
+    }
+    for (int i = 0; i < 5000; ++i) {
+        right.insertTuple({{i, i % 100}});
+    }
+    EXPECT_LT(left.getNumPages(), right.getNumPages());
+
+    db::join(left, right, out, {"id", db::PredicateOp::EQ, "id"});
+    int i = 0;
+    for (const auto &t: out) {
+        EXPECT_EQ(std::get<int>(t.get_field(0)), std::get<int>(t.get_field(2)) % 100);
+        EXPECT_EQ(std::get<std::string>(t.get_field(1)), "Hello");
+        ++i;
+    }
+    // Each of the 10 keys appears twice on the left and 50 times on the right.
+    EXPECT_EQ(i, 10 * 2 * 50);
+}
+
+TEST(JoinTest, GraceHashJoin) {
+    std::vector<db::type_t> types1{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+    std::vector<std::string> names1{"id", "name", "price"};
+    db::TupleDesc td1(types1, names1);
+
+    std::vector<db::type_t> types2{db::type_t::INT, db::type_t::INT};
+    std::vector<std::string> names2{"quantity", "id"};
+    db::TupleDesc td2(types2, names2);
+
+    std::vector<db::type_t> types3{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE, db::type_t::INT};
+    std::vector<std::string> names3{"id", "name", "price", "quantity"};
+    db::TupleDesc td3(types3, names3);
+
+    const char *left_name = "left.in";
+    const char *right_name = "right.in";
+    const char *out_name = "heapfile.out";
+    std::remove(left_name);
+    std::remove(right_name);
+    std::remove(out_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(left_name, td1));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(right_name, td2));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(out_name, td3));
+    auto &left = db::getDatabase().get(left_name);
+    auto &right = db::getDatabase().get(right_name);
+    auto &out = db::getDatabase().get(out_name);
+
+    std::unordered_set<int> values;
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<> dis(-100000, 100000);
+    while (values.size() < 2000) {
+        values.insert(dis(gen));
+    }
+
+    int expected = 0;
+    for (const auto &i: values) {
+        left.insertTuple({{i, "Hello", 3.14}});
+        if (dis(gen) % 2 == 0) {
+            right.insertTuple({{10 + i, i}});
+            ++expected;
+        }
+    }
+
+    // Neither input fits in a one page budget, so both are partitioned to disk.
+    EXPECT_GT(right.getNumPages(), 1);
+    db::grace_hash_join(left, right, out, {"id", db::PredicateOp::EQ, "id"}, 1);
+    int i = 0;
+    for (const auto &t: out) {
+        EXPECT_EQ(std::get<int>(t.get_field(3)), std::get<int>(t.get_field(0)) + 10);
+        ++i;
+    }
+    EXPECT_EQ(i, expected);
+}
+
+TEST(JoinTest, SortMergeBTree) {
+    std::vector<db::type_t> types1{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+    std::vector<std::string> names1{"id", "name", "price"};
+    db::TupleDesc td1(types1, names1);
+
+    std::vector<db::type_t> types2{db::type_t::INT, db::type_t::INT};
+    std::vector<std::string> names2{"quantity", "id"};
+    db::TupleDesc td2(types2, names2);
+
+    std::vector<db::type_t> types3{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE, db::type_t::INT};
+    std::vector<std::string> names3{"id", "name", "price", "quantity"};
+    db::TupleDesc td3(types3, names3);
+
+    const char *left_name = "left.in";
+    const char *right_name = "right.in";
+    const char *out_name = "heapfile.out";
+    std::remove(left_name);
+    std::remove(right_name);
+    std::remove(out_name);
+    db::getDatabase().add(std::make_unique<db::BTreeFile>(left_name, td1, 0));
+    db::getDatabase().add(std::make_unique<db::BTreeFile>(right_name, td2, 1));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(out_name, td3));
+    auto &left = db::getDatabase().get(left_name);
+    auto &right = db::getDatabase().get(right_name);
+    auto &out = db::getDatabase().get(out_name);
+
+    std::unordered_set<int> values;
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<> dis(-100000, 100000);
+    while (values.size() < 2000) {
+        values.insert(dis(gen));
+    }
+
+    int expected = 0;
+    for (const auto &i: values) {
+        left.insertTuple({{i, "Hello", 3.14}});
+        if (dis(gen) % 2 == 0) {
+            right.insertTuple({{10 + i, i}});
+            ++expected;
+        }
+    }
+
+    // Both inputs iterate in key order, so the merge emits the output sorted on the join field.
+    db::join(left, right, out, {"id", db::PredicateOp::EQ, "id"});
+    int i = 0;
+    int prev = std::numeric_limits<int>::min();
+    for (const auto &t: out) {
+        int id = std::get<int>(t.get_field(0));
+        EXPECT_LT(prev, id);
+        EXPECT_EQ(std::get<int>(t.get_field(3)), id + 10);
+        prev = id;
+        ++i;
+    }
+    EXPECT_EQ(i, expected);
+}
+
+TEST(JoinTest, SortMergeRange) {
+    std::vector<db::type_t> types1{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+    std::vector<std::string> names1{"id", "name", "price"};
+    db::TupleDesc td1(types1, names1);
+
+    std::vector<db::type_t> types2{db::type_t::INT, db::type_t::INT};
+    std::vector<std::string> names2{"quantity", "id"};
+    db::TupleDesc td2(types2, names2);
+
+    std::vector<db::type_t> types3{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE, db::type_t::INT,
+                                   db::type_t::INT};
+    std::vector<std::string> names3{"id1", "name", "price", "quantity", "id2"};
+    db::TupleDesc td3(types3, names3);
+
+    std::vector<int> lvalues;
+    std::vector<int> rvalues;
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<> dis(-1000, 1000);
+    while (lvalues.size() < 150) {
+        lvalues.push_back(dis(gen));
+    }
+    while (rvalues.size() < 600) {
+        rvalues.push_back(dis(gen));
+    }
+
+    for (auto op: {db::PredicateOp::LT, db::PredicateOp::LE, db::PredicateOp::GT, db::PredicateOp::GE}) {
+        const char *left_name = "left.in";
+        const char *right_name = "right.in";
+        const char *out_name = "heapfile.out";
+        std::remove(left_name);
+        std::remove(right_name);
+        std::remove(out_name);
+        db::getDatabase().add(std::make_unique<db::HeapFile>(left_name, td1));
+        db::getDatabase().add(std::make_unique<db::HeapFile>(right_name, td2));
+        db::getDatabase().add(std::make_unique<db::HeapFile>(out_name, td3));
+        auto &left = db::getDatabase().get(left_name);
+        auto &right = db::getDatabase().get(right_name);
+        auto &out = db::getDatabase().get(out_name);
+
+        for (const auto &i: lvalues) {
+            left.insertTuple({{i, "Hello", 3.14}});
+        }
+        for (const auto &i: rvalues) {
+            right.insertTuple({{i + 10, i}});
+        }
+
+        size_t expected = 0;
+        for (const auto &l: lvalues) {
+            for (const auto &r: rvalues) {
+                switch (op) {
+                    case db::PredicateOp::LT: expected += l < r; break;
+                    case db::PredicateOp::LE: expected += l <= r; break;
+                    case db::PredicateOp::GT: expected += l > r; break;
+                    case db::PredicateOp::GE: expected += l >= r; break;
+                    default: break;
+                }
+            }
+        }
+
+        // A one page budget forces the external sort to produce and merge several runs per input.
+        db::sort_merge_join(left, right, out, {"id", op, "id"}, 1);
+        size_t i = 0;
+        for (const auto &t: out) {
+            EXPECT_EQ(std::get<int>(t.get_field(3)), std::get<int>(t.get_field(4)) + 10);
+            ++i;
+        }
+        EXPECT_EQ(i, expected);
+
+        db::getDatabase().getBufferPool().discardFile(left_name);
+        db::getDatabase().getBufferPool().discardFile(right_name);
+        db::getDatabase().getBufferPool().discardFile(out_name);
+        db::getDatabase().remove(left_name);
+        db::getDatabase().remove(right_name);
+        db::getDatabase().remove(out_name);
+    }
+}
+
+TEST(JoinTest, BlockNestedLoop) {
+    std::vector<db::type_t> types1{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+    std::vector<std::string> names1{"id", "name", "price"};
+    db::TupleDesc td1(types1, names1);
+
+    std::vector<db::type_t> types2{db::type_t::INT, db::type_t::INT};
+    std::vector<std::string> names2{"quantity", "id"};
+    db::TupleDesc td2(types2, names2);
+
+    std::vector<db::type_t> types3{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE, db::type_t::INT,
+                                   db::type_t::INT};
+    std::vector<std::string> names3{"id1", "name", "price", "quantity", "id2"};
+    db::TupleDesc td3(types3, names3);
+
+    const char *left_name = "left.in";
+    const char *right_name = "right.in";
+    const char *out_name = "heapfile.out";
+    std::remove(left_name);
+    std::remove(right_name);
+    std::remove(out_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(left_name, td1));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(right_name, td2));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(out_name, td3));
+    auto &left = db::getDatabase().get(left_name);
+    auto &right = db::getDatabase().get(right_name);
+    auto &out = db::getDatabase().get(out_name);
+
+    for (int i = 0; i < 500; ++i) {
+        left.insertTuple({{i % 50, "Hello", 3.14}});
+    }
+    for (int i = 0; i < 100; ++i) {
+        right.insertTuple({{i, i % 50}});
+    }
+
+    // 500 left tuples span 10 pages, so a 3 page block scans the right input 4 times.
+    EXPECT_EQ(left.getNumPages(), 10);
+    size_t before = right.getReads().size();
+    db::block_nested_loop_join(left, right, out, {"id", db::PredicateOp::NE, "id"}, 3);
+    int i = 0;
+    for (const auto &t: out) {
+        EXPECT_NE(t.get_field(0), t.get_field(4));
+        ++i;
+    }
+    EXPECT_EQ(i, 500 * 100 - 500 * 2);
+    EXPECT_LE(right.getReads().size() - before, 4);
+}
+
+TEST(JoinTest, IndexNestedLoop) {
+    std::vector<db::type_t> types1{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+    std::vector<std::string> names1{"id", "name", "price"};
+    db::TupleDesc td1(types1, names1);
+
+    std::vector<db::type_t> types2{db::type_t::INT, db::type_t::INT};
+    std::vector<std::string> names2{"quantity", "id"};
+    db::TupleDesc td2(types2, names2);
+
+    std::vector<db::type_t> types3{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE, db::type_t::INT};
+    std::vector<std::string> names3{"id", "name", "price", "quantity"};
+    db::TupleDesc td3(types3, names3);
+
+    const char *left_name = "left.in";
+    const char *right_name = "right.in";
+    const char *out_name = "heapfile.out";
+    std::remove(left_name);
+    std::remove(right_name);
+    std::remove(out_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(left_name, td1));
+    db::getDatabase().add(std::make_unique<db::BTreeFile>(right_name, td2, 1));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(out_name, td3));
+    auto &left = db::getDatabase().get(left_name);
+    auto &right = db::getDatabase().get(right_name);
+    auto &out = db::getDatabase().get(out_name);
+
+    for (int i = 0; i < 100000; ++i) {
+        right.insertTuple({{i + 10, i}});
+    }
+    for (int i = 0; i < 20; ++i) {
+        left.insertTuple({{i * 7919 - 1000, "Hello", 3.14}});
+    }
+
+    // The outer input is tiny compared to the index, so each left tuple only reads one path of the tree.
+    size_t before = right.getReads().size();
+    db::join(left, right, out, {"id", db::PredicateOp::EQ, "id"});
+    EXPECT_LT(right.getReads().size() - before, right.getNumPages() / 4);
+    int i = 0;
+    for (const auto &t: out) {
+        EXPECT_EQ(std::get<int>(t.get_field(3)), std::get<int>(t.get_field(0)) + 10);
+        ++i;
+    }
+    // Keys 6919, 14838, ..., 94028 exist on the right, -1000 and the keys past 99999 do not.
+    EXPECT_EQ(i, 12);
+}
@@ -0,0 +1,101 @@
+#include <db/Database.hpp>
+#include <db/HeapFile.hpp>
+#include <db/Operator.hpp>
+#include <gtest/gtest.h>
+#include <map>
+
+TEST(OperatorTest, Pipeline) {
+    std::vector<db::type_t> types1{db::type_t::INT, db::type_t::CHAR, db::type_t::DOUBLE};
+    std::vector<std::string> names1{"id", "name", "price"};
+    db::TupleDesc td1(types1, names1);
+
+    std::vector<db::type_t> types2{db::type_t::INT, db::type_t::INT};
+    std::vector<std::string> names2{"quantity", "id"};
+    db::TupleDesc td2(types2, names2);
+
+    const char *left_name = "left.in";
+    const char *right_name = "right.in";
+    std::remove(left_name);
+    std::remove(right_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(left_name, td1));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(right_name, td2));
+    auto &left = db::getDatabase().get(left_name);
+    auto &right = db::getDatabase().get(right_name);
+
+    for (int i = 0; i < 3000; ++i) {
+        left.insertTuple({{i, i % 3 == 0 ? "a" : "b", i * 0.25}});
+    }
+    std::map<std::string, std::pair<int, int>> expected;
+    for (int i = 0; i < 5000; ++i) {
+        int quantity = i % 11, id = i % 4000;
+        right.insertTuple({{quantity, id}});
+        if (id < 3000 && id * 0.25 < 500.0 && quantity >= 5) {
+            auto &e = expected[id % 3 == 0 ? "a" : "b"];
+            e.first += quantity;
+            ++e.second;
+        }
+    }
+
+    // filter -> join -> project -> filter -> aggregate, with no intermediate file.
+    auto cheap = std::make_unique<db::FilterOperator>(
+            std::make_unique<db::ScanOperator>(left),
+            std::vector<db::FilterPredicate>{{"price", db::PredicateOp::LT, 500.0}});
+    auto joined = std::make_unique<db::HashJoinOperator>(std::move(cheap), std::make_unique<db::ScanOperator>(right),
+                                                         db::JoinPredicate{"id", db::PredicateOp::EQ, "id"});
+    EXPECT_EQ(joined->getTupleDesc().size(), 4);
+    auto projected = std::make_unique<db::ProjectOperator>(std::move(joined),
+                                                           std::vector<std::string>{"name", "quantity", "id"});
+    auto large = std::make_unique<db::FilterOperator>(
+            std::move(projected), std::vector<db::FilterPredicate>{{"quantity", db::PredicateOp::GE, 5}});
+    db::AggregateOperator root(std::move(large), db::GroupBy{{"name"}, {{db::AggregateOp::SUM, "quantity"},
+                                                                        {db::AggregateOp::COUNT, "id"}}});
+    EXPECT_EQ(root.getTupleDesc().index_of("sum(quantity)"), 1);
+
+    root.open();
+    db::Batch batch;
+    size_t groups = 0;
+    while (root.next(batch)) {
+        for (size_t row = 0; row < batch.size(); ++row) {
+            const auto &e = expected.at(std::get<std::string>(batch.get_field(row, 0)));
+            EXPECT_EQ(std::get<int>(batch.get_field(row, 1)), e.first);
+            EXPECT_EQ(std::get<int>(batch.get_field(row, 2)), e.second);
+            ++groups;
+        }
+    }
+    root.close();
+    EXPECT_EQ(groups, expected.size());
+}
+
+TEST(OperatorTest, NestedLoopJoin) {
+    std::vector<db::type_t> types{db::type_t::INT};
+    std::vector<std::string> names{"id"};
+    db::TupleDesc td(types, names);
+
+    const char *left_name = "left.in";
+    const char *right_name = "right.in";
+    std::remove(left_name);
+    std::remove(right_name);
+    db::getDatabase().add(std::make_unique<db::HeapFile>(left_name, td));
+    db::getDatabase().add(std::make_unique<db::HeapFile>(right_name, td));
+    auto &left = db::getDatabase().get(left_name);
+    auto &right = db::getDatabase().get(right_name);
+    for (int i = 0; i < 100; ++i) left.insertTuple({{i}});
+    for (int i = 0; i < 100; ++i) right.insertTuple({{i}});
+
+    db::NestedLoopJoinOperator op(std::make_unique<db::ScanOperator>(left), std::make_unique<db::ScanOperator>(right),
+                                  {"id", db::PredicateOp::LT, "id"});
+    // Both fields are kept, the right one renamed.
+    EXPECT_EQ(op.getTupleDesc().index_of("id2"), 1);
+    size_t count = 0;
+    db::Batch batch;
+    op.open();
+    while (op.next(batch)) {
+        EXPECT_LE(batch.size(), db::BATCH_SIZE);
+        for (size_t row = 0; row < batch.size(); ++row) {
+            EXPECT_LT(std::get<int>(batch.get_field(row, 0)), std::get<int>(batch.get_field(row, 1)));
+            ++count;
+        }
+    }
+    op.close();
+    EXPECT_EQ(count, 100 * 99 / 2);
+}